@@ -0,0 +1,293 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: bench.cpp
+// DATE: 10/19/2026
+// DESC: Execution benchmark driver. Runs each benchmark program with
+//       every execution engine and reports the time per run and the
+//       number of operations per second. Operations are the statements
+//       executed by the AST interpreter, so rates are comparable
+//       across engines. For the bytecode VMs the number of instructions
+//       executed is also reported (from a separate counting run), and
+//       for the engines sharing the runtime the peak size of the
+//       object heap (see heap.h).
+//       The heap allocations made while running are counted too (by
+//       replacing operator new). Each engine's output is checked
+//       against the AST interpreter's.
+//       The jit engine is the VM compiling hot functions to machine
+//       code (see vm.h), and the speedup of each engine over the VM
+//       interpreting is reported too.
+//       bench_fat is the same benchmark built with the tagged union
+//       value representation (see value.h).
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <new>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "interpreter.h"
+#include "runtime.h"
+#include "closure_compiler.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "vm.h"
+#include "reg_bytecode.h"
+#include "reg_compiler.h"
+#include "reg_vm.h"
+
+using namespace std;
+
+#ifndef BENCH_DIR
+#define BENCH_DIR "bench"
+#endif
+
+
+// the programs run when none are given on the command line
+const vector<string> default_programs = {"fib.mypl", "tree.mypl", "loops.mypl",
+                                          "list.mypl", "arith.mypl", "print.mypl",
+                                          "strings.mypl", "nodes.mypl", "temps.mypl"};
+
+// the engines compared (the first is the reference)
+const vector<string> engines = {"ast", "closure", "vm", "reg", "jit"};
+
+
+// heap allocations made so far
+long allocations = 0;
+
+// (the replacements are kept out of line, so GCC does not inline new
+// into malloc and then take deletes for mismatched frees)
+#if defined(__GNUC__)
+#define REPLACEMENT __attribute__((noinline))
+#else
+#define REPLACEMENT
+#endif
+
+REPLACEMENT void* operator new(size_t size)
+{
+  ++allocations;
+  void* p = malloc(size ? size : 1);
+  if (not p)
+    throw bad_alloc();
+  return p;
+}
+
+REPLACEMENT void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+// (every form of delete frees what the counting new allocated)
+REPLACEMENT void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+REPLACEMENT void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+REPLACEMENT void operator delete[](void* p) noexcept
+{
+  free(p);
+}
+
+REPLACEMENT void operator delete[](void* p, size_t) noexcept
+{
+  free(p);
+}
+
+
+// parse the given file into the program node
+void parse_file(const string& path, Program& program)
+{
+  ifstream input(path);
+  if (not input)
+    throw MyPLException(RUNTIME, "unable to open '" + path + "'", 0, 0);
+  Lexer lexer(input);
+  Parser parser(lexer);
+  parser.parse(program);
+}
+
+
+// time in seconds since start
+double elapsed(chrono::steady_clock::time_point start)
+{
+  chrono::duration<double> d = chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+
+// run the program once with the given engine, returning the time spent
+// executing (compilation is excluded) and setting the heap allocations
+// made executing and the peak size of the object heap (0 for the AST
+// interpreter); if instrs is given, the VMs count the instructions they
+// execute
+double run_engine(const string& engine, Program& program, ostream& out,
+                  long& ops, long& allocs, size_t& heap, long* instrs = nullptr)
+{
+  heap = 0;
+  if (engine == "vm" or engine == "jit") {
+    Module module;
+    Compiler compiler(module);
+    program.accept(compiler);
+    Runtime runtime(out);
+    VM vm(runtime, module);
+    vm.use_jit(engine == "jit");
+    vm.count_instructions(instrs != nullptr);
+    long before = allocations;
+    auto start = chrono::steady_clock::now();
+    vm.run();
+    double secs = elapsed(start);
+    allocs = allocations - before;
+    if (instrs)
+      *instrs = vm.instructions();
+    heap = runtime.heap().stats().peak_committed;
+    return secs;
+  }
+  if (engine == "reg") {
+    RegModule module;
+    RegCompiler compiler(module);
+    program.accept(compiler);
+    Runtime runtime(out);
+    RegVM vm(runtime, module);
+    vm.count_instructions(instrs != nullptr);
+    long before = allocations;
+    auto start = chrono::steady_clock::now();
+    vm.run();
+    double secs = elapsed(start);
+    allocs = allocations - before;
+    if (instrs)
+      *instrs = vm.instructions();
+    heap = runtime.heap().stats().peak_committed;
+    return secs;
+  }
+  if (engine == "closure") {
+    Runtime runtime(out);
+    ClosureCompiler compiler(runtime);
+    program.accept(compiler);
+    long before = allocations;
+    auto start = chrono::steady_clock::now();
+    compiler.run();
+    double secs = elapsed(start);
+    allocs = allocations - before;
+    heap = runtime.heap().stats().peak_committed;
+    return secs;
+  }
+  Interpreter interpreter(out);
+  long before = allocations;
+  auto start = chrono::steady_clock::now();
+  program.accept(interpreter);
+  double secs = elapsed(start);
+  allocs = allocations - before;
+  ops = interpreter.stmt_count();
+  return secs;
+}
+
+
+// an engine's results on a program (instrs and heap are 0 for engines
+// that do not count them)
+struct Result
+{
+  string engine;
+  double secs;
+  long instrs;
+  long allocs;
+  size_t heap;
+};
+
+
+void report(const string& program, const Result& r, long ops, double vm_secs)
+{
+  cout << left << setw(14) << program << setw(10) << r.engine
+       << right << fixed << setprecision(2) << setw(12) << r.secs * 1000
+       << setw(9) << vm_secs / r.secs << "x"
+       << setw(16) << setprecision(0) << ops / r.secs << setw(14);
+  if (r.instrs)
+    cout << r.instrs;
+  else
+    cout << "-";
+  cout << setw(12) << r.allocs << setw(12);
+  if (r.heap)
+    cout << r.heap / 1024;
+  else
+    cout << "-";
+  cout << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+  int runs = 3;
+  vector<string> programs;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-n" and i + 1 < argc)
+      runs = stoi(argv[++i]);
+    else
+      programs.push_back(arg);
+  }
+  if (programs.empty())
+    for (const string& p : default_programs)
+      programs.push_back(string(BENCH_DIR) + "/" + p);
+
+  cout << "vm dispatch: " << (MYPL_THREADED ? "direct threaded" : "switch") << endl
+       << "values: " << (MYPL_FAT_VALUES ? "tagged union" : "nan-boxed") << ", "
+       << sizeof(Value) << " bytes" << endl;
+  cout << left << setw(14) << "program" << setw(10) << "engine"
+       << right << setw(12) << "time (ms)" << setw(10) << "vs vm" << setw(16) << "ops/sec"
+       << setw(14) << "instrs" << setw(12) << "allocs" << setw(12) << "heap (KB)"
+       << endl;
+  try {
+    for (const string& path : programs) {
+      Program program;
+      parse_file(path, program);
+      string name = path.substr(path.find_last_of('/') + 1);
+      long ops = 0;
+      string expected;
+      vector<Result> results;
+      double vm_secs = 0;
+      for (const string& engine : engines) {
+        // best of the runs (each run starts from a fresh engine)
+        double best = 0;
+        long allocs = 0;
+        size_t heap = 0;
+        for (int r = 0; r < runs; ++r) {
+          ostringstream out;
+          double secs = run_engine(engine, program, out, ops, allocs, heap);
+          if (r == 0 or secs < best)
+            best = secs;
+          if (engine == "ast")
+            expected = out.str();
+          else if (out.str() != expected)
+            cout << "*** " << engine << " output differs on " << name << endl;
+        }
+        long instrs = 0;
+        if (engine == "vm" or engine == "reg") {
+          ostringstream out;
+          long counted_allocs;
+          run_engine(engine, program, out, ops, counted_allocs, heap, &instrs);
+        }
+        Result result = {engine, best, instrs, allocs, heap};
+        results.push_back(result);
+        if (engine == "vm")
+          vm_secs = best;
+      }
+      // (speedups are over the VM interpreting)
+      for (const Result& r : results)
+        report(name, r, ops, vm_secs);
+    }
+  } catch (MyPLException e) {
+    cout << e.to_string() << endl;
+    exit(1);
+  }
+}
@@ -0,0 +1,312 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: bytecode.h
+// DATE: 10/19/2026
+// DESC: Bytecode format for the MyPL stack VM. Instructions are a
+//       1-byte opcode followed by inline operands (u8 local slots and
+//       argument counts, u16 constant/name/type/function indexes and
+//       jump targets, little endian). Also includes a disassembler.
+//       Modules can also be saved to and mapped from images (image.h).
+//----------------------------------------------------------------------
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "value.h"
+#include "runtime.h"
+
+
+enum OpCode : uint8_t {
+  // constants
+  OP_NIL, OP_TRUE, OP_FALSE, OP_CONST,
+  // locals and the operand stack
+  OP_LOAD, OP_STORE, OP_POP, OP_DUP,
+  // struct objects (the local forms for objects that do not escape
+  // their function, see escape.h)
+  OP_NEW, OP_GETFIELD, OP_SETFIELD, OP_NEW_LOCAL, OP_SETFIELD_LOCAL,
+  // arithmetic and comparison
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+  OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE,
+  OP_NOT, OP_NEG,
+  // control flow
+  OP_JUMP, OP_JUMP_IF_FALSE, OP_JUMP_IF_FALSE_OR_POP, OP_JUMP_IF_TRUE_OR_POP,
+  // counted loops (the counter's slot, followed by the limit's)
+  OP_FOR_PREP, OP_FOR_LOOP,
+  // functions (user functions by index, built-ins by id)
+  OP_CALL, OP_BUILTIN, OP_RETURN,
+  // raise a runtime error
+  OP_ERROR,
+  OP_COUNT
+};
+
+
+// operand layout of an instruction
+enum OperandFormat {NO_ARGS, U8_ARG, U16_ARG, U16_U8_ARGS};
+
+
+struct OpInfo
+{
+  const char* name;
+  OperandFormat format;
+};
+
+
+const OpInfo op_info[OP_COUNT] = {
+  {"NIL", NO_ARGS}, {"TRUE", NO_ARGS}, {"FALSE", NO_ARGS}, {"CONST", U16_ARG},
+  {"LOAD", U8_ARG}, {"STORE", U8_ARG}, {"POP", NO_ARGS}, {"DUP", NO_ARGS},
+  {"NEW", U16_ARG}, {"GETFIELD", U16_ARG}, {"SETFIELD", U16_ARG},
+  {"NEW_LOCAL", U16_ARG}, {"SETFIELD_LOCAL", U16_ARG},
+  {"ADD", NO_ARGS}, {"SUB", NO_ARGS}, {"MUL", NO_ARGS}, {"DIV", NO_ARGS},
+  {"MOD", NO_ARGS}, {"EQ", NO_ARGS}, {"NE", NO_ARGS}, {"LT", NO_ARGS},
+  {"LE", NO_ARGS}, {"GT", NO_ARGS}, {"GE", NO_ARGS}, {"NOT", NO_ARGS},
+  {"NEG", NO_ARGS}, {"JUMP", U16_ARG}, {"JUMP_IF_FALSE", U16_ARG},
+  {"JUMP_IF_FALSE_OR_POP", U16_ARG}, {"JUMP_IF_TRUE_OR_POP", U16_ARG},
+  {"FOR_PREP", U16_U8_ARGS}, {"FOR_LOOP", U16_U8_ARGS}, {"CALL", U16_U8_ARGS},
+  {"BUILTIN", U16_U8_ARGS}, {"RETURN", NO_ARGS},
+  {"ERROR", U16_ARG}
+};
+
+
+// size in bytes of an instruction (including the opcode)
+int instruction_size(uint8_t op)
+{
+  switch(op_info[op].format) {
+    case U8_ARG: return 2;
+    case U16_ARG: return 3;
+    case U16_U8_ARGS: return 4;
+    default: return 1;
+  }
+}
+
+
+// source location of the instruction starting at offset
+struct Position
+{
+  int offset;
+  int line;
+  int column;
+};
+
+static_assert(sizeof(Position) == 12, "positions are stored as-is in images");
+
+
+// a local variable's slot over the code range [start, end) where it
+// is in scope (only recorded when compiling in debug mode)
+struct LocalName
+{
+  std::string name;
+  int slot;
+  int start;
+  int end;
+};
+
+
+// a function's code and positions are either its own (as compiled) or
+// in a mapped image
+struct Function
+{
+  std::string name;
+  int param_count = 0;
+  int local_count = 0;
+  std::vector<uint8_t> code;
+  std::vector<Position> positions;
+  std::vector<LocalName> local_names;
+  const uint8_t* mapped_code = nullptr;
+  int mapped_code_size = 0;
+  const Position* mapped_positions = nullptr;
+  int mapped_position_count = 0;
+
+  const uint8_t* bytes() const {return mapped_code ? mapped_code : code.data();}
+  int size() const {return mapped_code ? mapped_code_size : code.size();}
+};
+
+
+// a user-defined type (fields with constant initializers are set from
+// defaults, the rest by the type's init function, which is called with
+// the new object and returns it)
+struct TypeDef
+{
+  std::string name;
+  std::vector<std::string> fields;
+  std::vector<Value> defaults;
+  int init_function = -1;
+};
+
+
+class Image;
+
+// a compiled program (when mapped from an image, the constants are
+// left in the image and materialized by the VM as they are needed)
+struct Module
+{
+  std::vector<Value> constants;
+  std::vector<std::string> names;
+  std::vector<TypeDef> types;
+  std::vector<Function> functions;
+  const Image* image = nullptr;
+};
+
+
+//----------------------------------------------------------------------
+// Operand access
+//----------------------------------------------------------------------
+
+
+inline int read_u16(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+
+inline void write_u16(uint8_t* p, int v)
+{
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+}
+
+
+// the source location of the instruction at offset in positions
+// recorded in code order (the last one recorded for it, or 0, 0 if
+// none was), by binary search
+Position find_position(const Position* begin, const Position* end, int offset)
+{
+  const Position* p = std::upper_bound(begin, end, offset,
+    [](int off, const Position& q) {return off < q.offset;});
+  if (p != begin and p[-1].offset == offset)
+    return p[-1];
+  return {offset, 0, 0};
+}
+
+
+// the source location of an instruction (0, 0 if not recorded)
+Position find_position(const Function& fun, int offset)
+{
+  if (fun.mapped_positions)
+    return find_position(fun.mapped_positions,
+                         fun.mapped_positions + fun.mapped_position_count, offset);
+  return find_position(fun.positions.data(),
+                       fun.positions.data() + fun.positions.size(), offset);
+}
+
+
+// the key a compiler shares a constant by: its kind and exact payload
+// (a double's bits, a string's bytes)
+std::string constant_key(const Value& val)
+{
+  std::string key(1, (char)val.kind());
+  switch(val.kind()) {
+    case V_INT: {
+      int i = val.as_int();
+      key.append(reinterpret_cast<const char*>(&i), sizeof(i));
+      break;
+    }
+    case V_DOUBLE: {
+      double d = val.as_double();
+      key.append(reinterpret_cast<const char*>(&d), sizeof(d));
+      break;
+    }
+    case V_BOOL: key += val.as_bool() ? '1' : '0'; break;
+    case V_CHAR: key += val.as_char(); break;
+    case V_STRING: key += val.as_string(); break;
+    default: break;
+  }
+  return key;
+}
+
+
+//----------------------------------------------------------------------
+// Disassembler
+//----------------------------------------------------------------------
+
+
+std::string constant_string(const Value& val)
+{
+  switch(val.kind()) {
+    case V_INT: return std::to_string(val.as_int());
+    case V_DOUBLE: return std::to_string(val.as_double());
+    case V_BOOL: return val.as_bool() ? "true" : "false";
+    case V_CHAR: return "'" + std::string(1, val.as_char()) + "'";
+    case V_STRING: {
+      std::string s;
+      for (char c : val.as_string())
+        s += c == '\n' ? "\\n" : c == '\t' ? "\\t" : std::string(1, c);
+      return "\"" + s + "\"";
+    }
+    default: return "nil";
+  }
+}
+
+
+void disassemble(const Module& module, const Function& fun, std::ostream& out)
+{
+  out << "function " << fun.name << " (params " << fun.param_count
+      << ", locals " << fun.local_count << ")" << std::endl;
+  const uint8_t* code = fun.bytes();
+  int i = 0;
+  while (i < fun.size()) {
+    uint8_t op = code[i];
+    const uint8_t* args = code + i + 1;
+    out << "  " << std::setw(4) << std::setfill('0') << i << std::setfill(' ')
+        << "  " << std::left << std::setw(22) << op_info[op].name << std::right;
+    std::string comment;
+    switch(op_info[op].format) {
+      case U8_ARG:
+        out << (int)args[0];
+        for (const LocalName& l : fun.local_names)
+          if (l.slot == args[0] and l.start <= i and i < l.end)
+            comment = l.name;
+        break;
+      case U16_ARG: {
+        int k = read_u16(args);
+        out << k;
+        if ((op == OP_CONST or op == OP_ERROR) and k < (int)module.constants.size())
+          comment = constant_string(module.constants[k]);
+        else if (op == OP_GETFIELD or op == OP_SETFIELD or op == OP_SETFIELD_LOCAL)
+          comment = module.names[k];
+        else if (op == OP_NEW or op == OP_NEW_LOCAL)
+          comment = module.types[k].name;
+        break;
+      }
+      case U16_U8_ARGS:
+        out << read_u16(args) << " " << (int)args[2];
+        if (op == OP_CALL)
+          comment = module.functions[read_u16(args)].name;
+        else if (op == OP_BUILTIN)
+          comment = builtin_names[read_u16(args)];
+        break;
+      default:
+        break;
+    }
+    if (comment.size())
+      out << "\t; " << comment;
+    out << std::endl;
+    i += instruction_size(op);
+  }
+}
+
+
+void disassemble(const Module& module, std::ostream& out)
+{
+  for (const TypeDef& t : module.types) {
+    out << "type " << t.name << " {";
+    for (size_t i = 0; i < t.fields.size(); ++i)
+      out << (i ? ", " : "") << t.fields[i] << " = " << constant_string(t.defaults[i]);
+    out << "}";
+    if (t.init_function >= 0)
+      out << " init " << module.functions[t.init_function].name;
+    out << std::endl;
+  }
+  for (const Function& fun : module.functions) {
+    out << std::endl;
+    disassemble(module, fun, out);
+  }
+}
+
+
+#endif
@@ -0,0 +1,668 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: closure_compiler.h
+// DATE: 10/19/2026
+// DESC: Closure-compilation execution engine for MyPL. Each AST node
+//       is visited once and turned into a pre-bound C++ callable, with
+//       variables resolved to frame slots, operators selected, and
+//       literal operands converted up front. Running the program then
+//       only calls the closures (no visitor dispatch or name lookup).
+//----------------------------------------------------------------------
+
+#ifndef CLOSURE_COMPILER_H
+#define CLOSURE_COMPILER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include "lexer.h"
+#include "ast.h"
+#include "value.h"
+#include "runtime.h"
+
+
+// the locals of one function activation and its return value
+struct ClosureFrame
+{
+  Value* slots;
+  Value ret;
+};
+
+// compiled expressions produce a value, compiled statements return
+// true when a return statement was executed
+typedef std::function<Value(ClosureFrame&)> ExprFn;
+typedef std::function<bool(ClosureFrame&)> StmtFn;
+
+
+class ClosureCompiler : public Visitor
+{
+public:
+  // constructor
+  ClosureCompiler(Runtime& runtime) : rt(runtime) {}
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+  // run main (after the program has been compiled)
+  void run();
+
+private:
+  // a compiled function (slot_count is known once the body is compiled)
+  struct Function
+  {
+    Token id;
+    int param_count = 0;
+    int slot_count = 0;
+    StmtFn body;
+  };
+
+  Runtime& rt;
+
+  // functions and types by name, field initializers by type id
+  std::list<Function> function_list;
+  std::unordered_map<std::string,Function*> functions;
+  std::unordered_map<std::string,int> type_ids;
+  std::vector<std::vector<std::pair<int,ExprFn>>> type_inits;
+
+  // compile-time scopes of the function being compiled
+  std::vector<std::unordered_map<std::string,int>> scopes;
+  int next_slot = 0;
+  int max_slots = 0;
+
+  // result of compiling the last visited node
+  ExprFn curr_expr;
+  StmtFn curr_stmt;
+
+  // helper functions
+  ExprFn compile(Expr& expr) {expr.accept(*this); return curr_expr;}
+  StmtFn compile_block(std::list<Stmt*>& stmts);
+  void push_scope() {scopes.emplace_back();}
+  void pop_scope();
+  int lookup(const std::string& name) const;
+  int declare(const std::string& name);
+  ExprFn condition(Expr& expr);
+  ExprFn binary(const Token& op, ExprFn lhs, Expr& rest);
+  ExprFn get_field(ExprFn base, const Token& field);
+  static bool int_constant(Expr& expr, int& val);
+  static ExprFn error_fn(const std::string& msg, const Token& token);
+};
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+void ClosureCompiler::pop_scope()
+{
+  next_slot -= scopes.back().size();
+  scopes.pop_back();
+}
+
+
+int ClosureCompiler::lookup(const std::string& name) const
+{
+  for (size_t i = scopes.size(); i > 0; --i) {
+    auto it = scopes[i-1].find(name);
+    if (it != scopes[i-1].end())
+      return it->second;
+  }
+  return -1;
+}
+
+
+// a redeclaration in the same scope reuses the existing slot
+int ClosureCompiler::declare(const std::string& name)
+{
+  auto it = scopes.back().find(name);
+  if (it != scopes.back().end())
+    return it->second;
+  int slot = next_slot++;
+  scopes.back()[name] = slot;
+  if (next_slot > max_slots)
+    max_slots = next_slot;
+  return slot;
+}
+
+
+ExprFn ClosureCompiler::error_fn(const std::string& msg, const Token& token)
+{
+  int line = token.line(), column = token.column();
+  return [=](ClosureFrame&) -> Value {
+    Runtime::error(msg, line, column);
+    return Value();
+  };
+}
+
+
+// true if the expression is a lone integer literal
+bool ClosureCompiler::int_constant(Expr& expr, int& val)
+{
+  SimpleTerm* term = dynamic_cast<SimpleTerm*>(expr.first);
+  if (expr.op or expr.negated or not term)
+    return false;
+  SimpleRValue* rval = dynamic_cast<SimpleRValue*>(term->rvalue);
+  if (not rval or rval->value.type() != INT_VAL)
+    return false;
+  val = std::stoi(rval->value.lexeme());
+  return true;
+}
+
+
+StmtFn ClosureCompiler::compile_block(std::list<Stmt*>& stmts)
+{
+  push_scope();
+  std::vector<StmtFn> fns;
+  for (Stmt* s : stmts) {
+    s->accept(*this);
+    fns.push_back(curr_stmt);
+  }
+  pop_scope();
+  if (fns.size() == 1)
+    return fns[0];
+  return [=](ClosureFrame& f) {
+    for (const StmtFn& s : fns)
+      if (s(f))
+        return true;
+    return false;
+  };
+}
+
+
+// a compiled boolean condition (checked once evaluated)
+ExprFn ClosureCompiler::condition(Expr& expr)
+{
+  ExprFn e = compile(expr);
+  return [=](ClosureFrame& f) {
+    Value v = e(f);
+    if (not v.is_bool())
+      Runtime::error("expecting boolean condition", 0, 0);
+    return v;
+  };
+}
+
+
+ExprFn ClosureCompiler::get_field(ExprFn base, const Token& field)
+{
+  Runtime* r = &rt;
+  std::string name = field.lexeme();
+  int line = field.line(), column = field.column();
+  // (type id, field index) of the last object accessed at this site
+  std::shared_ptr<std::pair<int,int>> cache(new std::pair<int,int>(-1, -1));
+  return [=](ClosureFrame& f) -> Value {
+    Object* obj = r->deref(base(f), name, line, column);
+    if (obj->type_id != cache->first) {
+      int i = r->field_index(obj->type_id, name);
+      if (i < 0)
+        Runtime::error("undefined field '" + name + "'", line, column);
+      *cache = std::make_pair(obj->type_id, i);
+    }
+    return obj->fields()[cache->second];
+  };
+}
+
+
+// the integer fast paths of the binary operators
+struct IntAdd {static Value apply(int x, int y) {return Value::from_int((unsigned)x + y);}};
+struct IntSub {static Value apply(int x, int y) {return Value::from_int((unsigned)x - y);}};
+struct IntMul {static Value apply(int x, int y) {return Value::from_int((unsigned)x * y);}};
+struct IntDiv {static Value apply(int x, int y) {return Value::from_int(x / y);}};
+struct IntMod {static Value apply(int x, int y) {return Value::from_int(x % y);}};
+struct IntEq {static Value apply(int x, int y) {return Value::from_bool(x == y);}};
+struct IntNe {static Value apply(int x, int y) {return Value::from_bool(x != y);}};
+struct IntLt {static Value apply(int x, int y) {return Value::from_bool(x < y);}};
+struct IntLe {static Value apply(int x, int y) {return Value::from_bool(x <= y);}};
+struct IntGt {static Value apply(int x, int y) {return Value::from_bool(x > y);}};
+struct IntGe {static Value apply(int x, int y) {return Value::from_bool(x >= y);}};
+
+
+// integer operator specialized for a constant right operand (k must
+// be a valid divisor for / and %)
+template<typename Op>
+ExprFn int_const_op(Runtime* r, TokenType op, ExprFn lhs, int k, int line, int column)
+{
+  return [=](ClosureFrame& f) {
+    Value a = lhs(f);
+    if (a.is_int())
+      return Op::apply(a.as_int(), k);
+    return r->binary(op, a, Value::from_int(k), line, column);
+  };
+}
+
+
+template<typename Op>
+ExprFn int_op(Runtime* r, TokenType op, ExprFn lhs, ExprFn rhs, int line, int column)
+{
+  bool divides = op == DIVIDE or op == MODULO;
+  return [=](ClosureFrame& f) {
+    Value a = lhs(f);
+    Value b = rhs(f);
+    if (a.is_int() and b.is_int() and
+        (not divides or (b.as_int() != 0 and b.as_int() != -1)))
+      return Op::apply(a.as_int(), b.as_int());
+    return r->binary(op, a, b, line, column);
+  };
+}
+
+
+template<typename Op>
+ExprFn select_op(Runtime* r, TokenType op, ExprFn lhs, ExprFn rhs, bool is_const,
+                 int k, int line, int column)
+{
+  if (is_const)
+    return int_const_op<Op>(r, op, lhs, k, line, column);
+  return int_op<Op>(r, op, lhs, rhs, line, column);
+}
+
+
+ExprFn ClosureCompiler::binary(const Token& op, ExprFn lhs, Expr& rest)
+{
+  Runtime* r = &rt;
+  TokenType t = op.type();
+  int line = op.line(), column = op.column();
+  ExprFn rhs = compile(rest);
+  // and/or short circuit on the (boolean) left operand
+  if (t == AND or t == OR) {
+    bool is_and = t == AND;
+    std::string msg = "expecting boolean operand for '" + op.lexeme() + "'";
+    return [=](ClosureFrame& f) {
+      Value a = lhs(f);
+      if (not a.is_bool())
+        Runtime::error(msg, line, column);
+      return a.as_bool() == is_and ? rhs(f) : a;
+    };
+  }
+  int k = 0;
+  bool is_const = int_constant(rest, k) and
+    not ((t == DIVIDE or t == MODULO) and (k == 0 or k == -1));
+  switch(t) {
+    case PLUS: return select_op<IntAdd>(r, t, lhs, rhs, is_const, k, line, column);
+    case MINUS: return select_op<IntSub>(r, t, lhs, rhs, is_const, k, line, column);
+    case MULTIPLY: return select_op<IntMul>(r, t, lhs, rhs, is_const, k, line, column);
+    case DIVIDE: return select_op<IntDiv>(r, t, lhs, rhs, is_const, k, line, column);
+    case MODULO: return select_op<IntMod>(r, t, lhs, rhs, is_const, k, line, column);
+    case EQUAL: return select_op<IntEq>(r, t, lhs, rhs, is_const, k, line, column);
+    case NOT_EQUAL: return select_op<IntNe>(r, t, lhs, rhs, is_const, k, line, column);
+    case LESS: return select_op<IntLt>(r, t, lhs, rhs, is_const, k, line, column);
+    case LESS_EQUAL: return select_op<IntLe>(r, t, lhs, rhs, is_const, k, line, column);
+    case GREATER: return select_op<IntGt>(r, t, lhs, rhs, is_const, k, line, column);
+    default: return select_op<IntGe>(r, t, lhs, rhs, is_const, k, line, column);
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Top-Level Visitor Functions
+//----------------------------------------------------------------------
+
+
+void ClosureCompiler::visit(Program& node)
+{
+  // declare every type and function first so that references can be
+  // bound regardless of declaration order
+  for (Decl* d : node.decls) {
+    TypeDecl* t = dynamic_cast<TypeDecl*>(d);
+    if (t) {
+      std::vector<std::string> fields;
+      for (VarDeclStmt* v : t->vdecls)
+        fields.push_back(v->id.lexeme());
+      type_ids[t->id.lexeme()] = rt.add_type(t->id.lexeme(), fields);
+    }
+    FunDecl* f = dynamic_cast<FunDecl*>(d);
+    if (f and not functions.count(f->id.lexeme())) {
+      function_list.emplace_back();
+      functions[f->id.lexeme()] = &function_list.back();
+    }
+    // (the arity is needed to link calls that precede the declaration)
+    if (f)
+      functions[f->id.lexeme()]->param_count = f->params.size();
+  }
+  type_inits.resize(rt.type_count());
+  for (Decl* d : node.decls)
+    d->accept(*this);
+}
+
+
+void ClosureCompiler::visit(FunDecl& node)
+{
+  Function& fun = *functions[node.id.lexeme()];
+  fun.id = node.id;
+  fun.param_count = node.params.size();
+  next_slot = max_slots = 0;
+  push_scope();
+  for (FunDecl::FunParam& p : node.params)
+    declare(p.id.lexeme());
+  // parameters always occupy the first slots (even if repeated)
+  next_slot = max_slots = std::max(max_slots, fun.param_count);
+  fun.body = compile_block(node.stmts);
+  pop_scope();
+  fun.slot_count = max_slots;
+}
+
+
+void ClosureCompiler::visit(TypeDecl& node)
+{
+  // field initializers are compiled without any visible variables
+  int type_id = type_ids[node.id.lexeme()];
+  std::vector<std::unordered_map<std::string,int>> saved;
+  saved.swap(scopes);
+  push_scope();
+  type_inits[type_id].clear();
+  for (VarDeclStmt* v : node.vdecls) {
+    int index = rt.field_index(type_id, v->id.lexeme());
+    type_inits[type_id].push_back(std::make_pair(index, compile(*v->expr)));
+  }
+  scopes.swap(saved);
+}
+
+
+void ClosureCompiler::run()
+{
+  auto main = functions.find("main");
+  if (main == functions.end())
+    throw MyPLException(RUNTIME, "undefined 'main' function", 0, 0);
+  std::vector<Value> slots(main->second->slot_count);
+  ClosureFrame frame = {slots.data(), Value()};
+  main->second->body(frame);
+}
+
+
+//----------------------------------------------------------------------
+// Statement Visitor Functions
+//----------------------------------------------------------------------
+
+
+void ClosureCompiler::visit(VarDeclStmt& node)
+{
+  ExprFn e = compile(*node.expr);
+  int slot = declare(node.id.lexeme());
+  curr_stmt = [=](ClosureFrame& f) {
+    f.slots[slot] = e(f);
+    return false;
+  };
+}
+
+
+void ClosureCompiler::visit(AssignStmt& node)
+{
+  ExprFn e = compile(*node.expr);
+  const Token& root = node.lvalue_list.front();
+  int slot = lookup(root.lexeme());
+  if (slot < 0) {
+    ExprFn err = error_fn("undefined variable '" + root.lexeme() + "'", root);
+    curr_stmt = [=](ClosureFrame& f) {e(f); err(f); return false;};
+    return;
+  }
+  if (node.lvalue_list.size() == 1) {
+    curr_stmt = [=](ClosureFrame& f) {
+      f.slots[slot] = e(f);
+      return false;
+    };
+    return;
+  }
+  // the path up to the last field gives the object to assign into
+  ExprFn base = [=](ClosureFrame& f) {return f.slots[slot];};
+  auto it = ++node.lvalue_list.begin();
+  for (; it != --node.lvalue_list.end(); ++it)
+    base = get_field(base, *it);
+  Runtime* r = &rt;
+  std::string name = it->lexeme();
+  int line = it->line(), column = it->column();
+  std::shared_ptr<std::pair<int,int>> cache(new std::pair<int,int>(-1, -1));
+  curr_stmt = [=](ClosureFrame& f) {
+    Value val = e(f);
+    Object* obj = r->deref(base(f), name, line, column);
+    if (obj->type_id != cache->first) {
+      int i = r->field_index(obj->type_id, name);
+      if (i < 0)
+        Runtime::error("undefined field '" + name + "'", line, column);
+      *cache = std::make_pair(obj->type_id, i);
+    }
+    r->heap().store(obj, cache->second, val);
+    return false;
+  };
+}
+
+
+void ClosureCompiler::visit(ReturnStmt& node)
+{
+  ExprFn e = compile(*node.expr);
+  curr_stmt = [=](ClosureFrame& f) {
+    f.ret = e(f);
+    return true;
+  };
+}
+
+
+void ClosureCompiler::visit(IfStmt& node)
+{
+  std::vector<std::pair<ExprFn,StmtFn>> parts;
+  ExprFn cond = condition(*node.if_part->expr);
+  parts.push_back(std::make_pair(cond, compile_block(node.if_part->stmts)));
+  for (BasicIf* else_if : node.else_ifs) {
+    cond = condition(*else_if->expr);
+    parts.push_back(std::make_pair(cond, compile_block(else_if->stmts)));
+  }
+  StmtFn else_body = compile_block(node.body_stmts);
+  if (parts.size() == 1) {
+    StmtFn body = parts[0].second;
+    curr_stmt = [=](ClosureFrame& f) {
+      return cond(f).as_bool() ? body(f) : else_body(f);
+    };
+    return;
+  }
+  curr_stmt = [=](ClosureFrame& f) {
+    for (const std::pair<ExprFn,StmtFn>& p : parts)
+      if (p.first(f).as_bool())
+        return p.second(f);
+    return else_body(f);
+  };
+}
+
+
+void ClosureCompiler::visit(WhileStmt& node)
+{
+  ExprFn cond = condition(*node.expr);
+  StmtFn body = compile_block(node.stmts);
+  curr_stmt = [=](ClosureFrame& f) {
+    while (cond(f).as_bool())
+      if (body(f))
+        return true;
+    return false;
+  };
+}
+
+
+void ClosureCompiler::visit(ForStmt& node)
+{
+  // bounds are evaluated once and the loop variable is a copy of the
+  // (hidden) counter
+  ExprFn start = compile(*node.start);
+  ExprFn end = compile(*node.end);
+  push_scope();
+  int slot = declare(node.var_id.lexeme());
+  StmtFn body = compile_block(node.stmts);
+  pop_scope();
+  int line = node.var_id.line(), column = node.var_id.column();
+  curr_stmt = [=](ClosureFrame& f) {
+    Value s = start(f);
+    Value e = end(f);
+    if (not s.is_int() or not e.is_int())
+      Runtime::error("expecting integer for loop bounds", line, column);
+    int last = e.as_int();
+    for (int i = s.as_int(); i <= last; ++i) {
+      f.slots[slot] = Value::from_int(i);
+      if (body(f))
+        return true;
+      if (i == last)
+        break;
+    }
+    return false;
+  };
+}
+
+
+//----------------------------------------------------------------------
+// Expression Visitor Functions
+//----------------------------------------------------------------------
+
+
+void ClosureCompiler::visit(Expr& node)
+{
+  node.first->accept(*this);
+  ExprFn e = curr_expr;
+  if (node.op)
+    e = binary(*node.op, e, *node.rest);
+  if (node.negated) {
+    curr_expr = [=](ClosureFrame& f) {
+      Value v = e(f);
+      if (not v.is_bool())
+        Runtime::error("expecting boolean operand for 'not'", 0, 0);
+      return Value::from_bool(not v.as_bool());
+    };
+  }
+  else
+    curr_expr = e;
+}
+
+
+void ClosureCompiler::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+
+void ClosureCompiler::visit(ComplexTerm& node)
+{
+  node.expr->accept(*this);
+}
+
+
+//----------------------------------------------------------------------
+// RValue Visitor Functions
+//----------------------------------------------------------------------
+
+
+void ClosureCompiler::visit(SimpleRValue& node)
+{
+  Value val = Runtime::literal(node.value);
+  curr_expr = [=](ClosureFrame&) {return val;};
+}
+
+
+void ClosureCompiler::visit(NewRValue& node)
+{
+  auto t = type_ids.find(node.type_id.lexeme());
+  if (t == type_ids.end()) {
+    curr_expr = error_fn("undefined type '" + node.type_id.lexeme() + "'",
+                         node.type_id);
+    return;
+  }
+  int type_id = t->second;
+  Runtime* r = &rt;
+  const std::vector<std::pair<int,ExprFn>>* inits = &type_inits[type_id];
+  curr_expr = [=](ClosureFrame&) {
+    // initializers run in their own (empty) frame
+    ClosureFrame init_frame = {nullptr, Value()};
+    Value obj = r->new_object(type_id);
+    for (const std::pair<int,ExprFn>& init : *inits)
+      r->heap().store(obj.as_object(), init.first, init.second(init_frame));
+    return obj;
+  };
+}
+
+
+void ClosureCompiler::visit(CallExpr& node)
+{
+  std::vector<ExprFn> args;
+  for (Expr* e : node.arg_list)
+    args.push_back(compile(*e));
+  const Token& id = node.function_id;
+  int line = id.line(), column = id.column();
+  auto fun = functions.find(id.lexeme());
+  int builtin = Runtime::builtin_id(id.lexeme());
+  if (fun != functions.end() and fun->second->param_count == (int)args.size()) {
+    Function* callee = fun->second;
+    curr_expr = [=](ClosureFrame& f) {
+      std::vector<Value> slots(callee->slot_count);
+      for (size_t i = 0; i < args.size(); ++i)
+        slots[i] = args[i](f);
+      ClosureFrame frame = {slots.data(), Value()};
+      callee->body(frame);
+      return frame.ret;
+    };
+  }
+  else if (fun == functions.end() and builtin >= 0 and args.size() <= 2) {
+    Runtime* r = &rt;
+    curr_expr = [=](ClosureFrame& f) {
+      Value vals[2];
+      for (size_t i = 0; i < args.size(); ++i)
+        vals[i] = args[i](f);
+      return r->call_builtin(builtin, vals, args.size(), line, column);
+    };
+  }
+  else {
+    // report the error once the arguments are evaluated
+    std::string msg = fun == functions.end() and builtin < 0 ? "undefined function '" :
+      "wrong number of arguments to '";
+    ExprFn err = error_fn(msg + id.lexeme() + "'", id);
+    curr_expr = [=](ClosureFrame& f) {
+      for (const ExprFn& a : args)
+        a(f);
+      return err(f);
+    };
+  }
+  ExprFn e = curr_expr;
+  curr_stmt = [=](ClosureFrame& f) {
+    e(f);
+    return false;
+  };
+}
+
+
+void ClosureCompiler::visit(IDRValue& node)
+{
+  const Token& root = node.path.front();
+  int slot = lookup(root.lexeme());
+  if (slot < 0) {
+    curr_expr = error_fn("undefined variable '" + root.lexeme() + "'", root);
+    return;
+  }
+  ExprFn e = [=](ClosureFrame& f) {return f.slots[slot];};
+  for (auto it = ++node.path.begin(); it != node.path.end(); ++it)
+    e = get_field(e, *it);
+  curr_expr = e;
+}
+
+
+void ClosureCompiler::visit(NegatedRValue& node)
+{
+  ExprFn e = compile(*node.expr);
+  Runtime* r = &rt;
+  curr_expr = [=](ClosureFrame& f) {return r->negate(e(f), 0, 0);};
+}
+
+
+#endif
@@ -0,0 +1,623 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: compiler.h
+// DATE: 10/19/2026
+// DESC: Compiles the MyPL AST into stack VM bytecode (see bytecode.h).
+//       Local variables are assigned frame slots and calls are linked
+//       to function indexes or built-in ids, so no names are looked up
+//       at run time. Objects that do not escape their function (see
+//       escape.h) are created with NEW_LOCAL, in the frame. In debug
+//       mode the local variable names are kept for the disassembler.
+//----------------------------------------------------------------------
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "ast.h"
+#include "runtime.h"
+#include "bytecode.h"
+#include "escape.h"
+
+
+class Compiler : public Visitor
+{
+public:
+  // constructor
+  Compiler(Module& target_module, bool debug_mode = false)
+    : module(target_module), debug(debug_mode) {}
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+private:
+  Module& module;
+  bool debug;
+
+  // the function being compiled
+  int curr_fun = -1;
+
+  // type ids, function indexes (the last declaration of a name wins),
+  // and interned constant and name indexes
+  std::unordered_map<std::string,int> type_ids;
+  std::unordered_map<std::string,int> function_ids;
+  int next_fun_decl = 0;
+  std::unordered_map<std::string,int> constant_index;
+  std::unordered_map<std::string,int> name_index;
+
+  // compile-time scopes of the function being compiled
+  std::vector<std::unordered_map<std::string,int>> scopes;
+  int next_slot = 0;
+
+  // the function's declarations of objects that do not escape, and
+  // the slots currently holding one
+  std::unordered_set<const VarDeclStmt*> local_objects;
+  bool object_slots[0x100] = {};
+
+  // helper functions
+  void error(const std::string& msg, const Token& token);
+  Function& fun() {return module.functions[curr_fun];}
+  int offset() {return fun().code.size();}
+  void mark(const Token& token);
+  void emit(uint8_t op);
+  void emit_u8(uint8_t op, int arg);
+  void emit_u16(uint8_t op, int arg);
+  int emit_jump(uint8_t op);
+  void patch_jump(int at);
+  void emit_error(const std::string& msg, const Token& token);
+  int add_constant(const Value& val);
+  int add_name(const std::string& name);
+  void begin_function(int index, const std::string& name, int param_count);
+  void end_function();
+  void push_scope() {scopes.emplace_back();}
+  void pop_scope();
+  int lookup(const std::string& name) const;
+  int declare(const std::string& name, const Token& token);
+  int hidden_slot(const Token& token) {return declare("." + std::to_string(next_slot), token);}
+  void block(std::list<Stmt*>& stmts);
+  static bool is_literal(Expr& expr, Token& value);
+};
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+void Compiler::error(const std::string& msg, const Token& token)
+{
+  throw MyPLException(SEMANTIC, msg, token.line(), token.column());
+}
+
+
+// record the source location of the next instruction
+void Compiler::mark(const Token& token)
+{
+  Position p = {offset(), token.line(), token.column()};
+  fun().positions.push_back(p);
+}
+
+
+void Compiler::emit(uint8_t op)
+{
+  fun().code.push_back(op);
+}
+
+
+void Compiler::emit_u8(uint8_t op, int arg)
+{
+  emit(op);
+  fun().code.push_back(arg);
+}
+
+
+// (an operand is an index of a constant, name, type or function, or a
+// jump target, none of which may pass 16 bits)
+void Compiler::emit_u16(uint8_t op, int arg)
+{
+  if (arg > 0xFFFF)
+    throw MyPLException(SEMANTIC, "function '" + fun().name + "' is too large", 0, 0);
+  emit(op);
+  fun().code.push_back(arg & 0xFF);
+  fun().code.push_back((arg >> 8) & 0xFF);
+}
+
+
+// emit a forward jump, returning the offset of the operand to patch
+int Compiler::emit_jump(uint8_t op)
+{
+  emit_u16(op, 0);
+  return offset() - 2;
+}
+
+
+void Compiler::patch_jump(int at)
+{
+  if (offset() > 0xFFFF)
+    throw MyPLException(SEMANTIC, "function '" + fun().name + "' is too large", 0, 0);
+  write_u16(&fun().code[at], offset());
+}
+
+
+void Compiler::emit_error(const std::string& msg, const Token& token)
+{
+  mark(token);
+  emit_u16(OP_ERROR, add_constant(Value::from_string(msg)));
+}
+
+
+int Compiler::add_constant(const Value& val)
+{
+  // constants are shared by kind and exact value
+  std::string key = constant_key(val);
+  auto it = constant_index.find(key);
+  if (it != constant_index.end())
+    return it->second;
+  module.constants.push_back(val);
+  int k = module.constants.size() - 1;
+  constant_index[key] = k;
+  return k;
+}
+
+
+int Compiler::add_name(const std::string& name)
+{
+  auto it = name_index.find(name);
+  if (it != name_index.end())
+    return it->second;
+  module.names.push_back(name);
+  int k = module.names.size() - 1;
+  name_index[name] = k;
+  return k;
+}
+
+
+void Compiler::begin_function(int index, const std::string& name, int param_count)
+{
+  curr_fun = index;
+  fun().name = name;
+  fun().param_count = param_count;
+  next_slot = 0;
+  push_scope();
+}
+
+
+void Compiler::end_function()
+{
+  // return nil if the end of the body is reached
+  emit(OP_NIL);
+  emit(OP_RETURN);
+  pop_scope();
+}
+
+
+void Compiler::pop_scope()
+{
+  if (debug) {
+    for (LocalName& l : fun().local_names)
+      if (l.end < 0 and scopes.back().count(l.name) and scopes.back()[l.name] == l.slot)
+        l.end = offset();
+  }
+  next_slot -= scopes.back().size();
+  scopes.pop_back();
+}
+
+
+int Compiler::lookup(const std::string& name) const
+{
+  for (size_t i = scopes.size(); i > 0; --i) {
+    auto it = scopes[i-1].find(name);
+    if (it != scopes[i-1].end())
+      return it->second;
+  }
+  return -1;
+}
+
+
+// a redeclaration in the same scope reuses the existing slot
+int Compiler::declare(const std::string& name, const Token& token)
+{
+  auto it = scopes.back().find(name);
+  if (it != scopes.back().end())
+    return it->second;
+  if (next_slot > 0xFF)
+    error("too many local variables in '" + fun().name + "'", token);
+  int slot = next_slot++;
+  scopes.back()[name] = slot;
+  object_slots[slot] = false;
+  if (debug and name[0] != '.') {
+    LocalName l = {name, slot, offset(), -1};
+    fun().local_names.push_back(l);
+  }
+  if (next_slot > fun().local_count)
+    fun().local_count = next_slot;
+  return slot;
+}
+
+
+void Compiler::block(std::list<Stmt*>& stmts)
+{
+  push_scope();
+  for (Stmt* s : stmts) {
+    s->accept(*this);
+    // (a call statement's result is discarded)
+    if (dynamic_cast<CallExpr*>(s))
+      emit(OP_POP);
+  }
+  pop_scope();
+}
+
+
+// true if the expression is a lone literal (or nil) value
+bool Compiler::is_literal(Expr& expr, Token& value)
+{
+  SimpleTerm* term = dynamic_cast<SimpleTerm*>(expr.first);
+  if (expr.op or expr.negated or not term)
+    return false;
+  SimpleRValue* rval = dynamic_cast<SimpleRValue*>(term->rvalue);
+  if (not rval)
+    return false;
+  value = rval->value;
+  return true;
+}
+
+
+//----------------------------------------------------------------------
+// Top-Level Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Compiler::visit(Program& node)
+{
+  // types are numbered up front (new needs the type id)
+  for (Decl* d : node.decls) {
+    TypeDecl* t = dynamic_cast<TypeDecl*>(d);
+    if (t and not type_ids.count(t->id.lexeme())) {
+      type_ids[t->id.lexeme()] = module.types.size();
+      module.types.emplace_back();
+    }
+  }
+  // as are functions, so calls (including forward ones) are linked
+  // directly (the init functions of types come after them)
+  for (Decl* d : node.decls) {
+    FunDecl* f = dynamic_cast<FunDecl*>(d);
+    if (f) {
+      function_ids[f->id.lexeme()] = module.functions.size();
+      module.functions.emplace_back();
+      module.functions.back().param_count = f->params.size();
+    }
+  }
+  for (Decl* d : node.decls)
+    d->accept(*this);
+}
+
+
+void Compiler::visit(FunDecl& node)
+{
+  local_objects = EscapeAnalysis::local_objects(node);
+  begin_function(next_fun_decl++, node.id.lexeme(), node.params.size());
+  for (FunDecl::FunParam& p : node.params)
+    declare(p.id.lexeme(), p.id);
+  // parameters always occupy the first slots (even if repeated)
+  while (next_slot < fun().param_count)
+    hidden_slot(node.id);
+  block(node.stmts);
+  end_function();
+}
+
+
+void Compiler::visit(TypeDecl& node)
+{
+  TypeDef& t = module.types[type_ids[node.id.lexeme()]];
+  t = TypeDef();
+  t.name = node.id.lexeme();
+  std::unordered_map<std::string,int> index;
+  std::vector<VarDeclStmt*> computed;
+  for (VarDeclStmt* v : node.vdecls) {
+    const std::string& name = v->id.lexeme();
+    if (not index.count(name)) {
+      index[name] = t.fields.size();
+      t.fields.push_back(name);
+      t.defaults.push_back(Value());
+    }
+    Token value;
+    if (is_literal(*v->expr, value))
+      t.defaults[index[name]] = Runtime::literal(value);
+    else
+      computed.push_back(v);
+  }
+  if (computed.empty())
+    return;
+  // the remaining fields are set by an init function that takes and
+  // returns the new object (its name cannot clash with a MyPL function)
+  std::vector<std::unordered_map<std::string,int>> saved;
+  saved.swap(scopes);
+  module.functions.emplace_back();
+  begin_function(module.functions.size() - 1, t.name + ".init", 1);
+  t.init_function = curr_fun;
+  hidden_slot(node.id);
+  for (VarDeclStmt* v : computed) {
+    v->expr->accept(*this);
+    emit_u8(OP_LOAD, 0);
+    mark(v->id);
+    emit_u16(OP_SETFIELD, add_name(v->id.lexeme()));
+  }
+  emit_u8(OP_LOAD, 0);
+  emit(OP_RETURN);
+  pop_scope();
+  scopes.swap(saved);
+}
+
+
+//----------------------------------------------------------------------
+// Statement Visitor Functions
+//----------------------------------------------------------------------
+
+
+// (an object that does not escape is allocated in the frame, see
+// escape.h)
+void Compiler::visit(VarDeclStmt& node)
+{
+  bool local = false;
+  if (local_objects.count(&node)) {
+    SimpleTerm* term = static_cast<SimpleTerm*>(node.expr->first);
+    auto t = type_ids.find(static_cast<NewRValue*>(term->rvalue)->type_id.lexeme());
+    if (t != type_ids.end()) {
+      emit_u16(OP_NEW_LOCAL, t->second);
+      local = true;
+    }
+  }
+  if (not local)
+    node.expr->accept(*this);
+  int slot = declare(node.id.lexeme(), node.id);
+  object_slots[slot] = local;
+  emit_u8(OP_STORE, slot);
+}
+
+
+void Compiler::visit(AssignStmt& node)
+{
+  node.expr->accept(*this);
+  const Token& root = node.lvalue_list.front();
+  int slot = lookup(root.lexeme());
+  if (slot < 0) {
+    emit_error("undefined variable '" + root.lexeme() + "'", root);
+    return;
+  }
+  if (node.lvalue_list.size() == 1) {
+    emit_u8(OP_STORE, slot);
+    return;
+  }
+  // the value is below the object whose field is assigned
+  emit_u8(OP_LOAD, slot);
+  auto it = ++node.lvalue_list.begin();
+  for (; it != --node.lvalue_list.end(); ++it) {
+    mark(*it);
+    emit_u16(OP_GETFIELD, add_name(it->lexeme()));
+  }
+  mark(*it);
+  bool local = node.lvalue_list.size() == 2 and object_slots[slot];
+  emit_u16(local ? OP_SETFIELD_LOCAL : OP_SETFIELD, add_name(it->lexeme()));
+}
+
+
+void Compiler::visit(ReturnStmt& node)
+{
+  node.expr->accept(*this);
+  emit(OP_RETURN);
+}
+
+
+void Compiler::visit(IfStmt& node)
+{
+  std::vector<int> exits;
+  std::vector<BasicIf*> parts(1, node.if_part);
+  parts.insert(parts.end(), node.else_ifs.begin(), node.else_ifs.end());
+  for (BasicIf* part : parts) {
+    part->expr->accept(*this);
+    mark(Token());
+    int next = emit_jump(OP_JUMP_IF_FALSE);
+    block(part->stmts);
+    exits.push_back(emit_jump(OP_JUMP));
+    patch_jump(next);
+  }
+  block(node.body_stmts);
+  for (int at : exits)
+    patch_jump(at);
+}
+
+
+void Compiler::visit(WhileStmt& node)
+{
+  int start = offset();
+  node.expr->accept(*this);
+  mark(Token());
+  int exit = emit_jump(OP_JUMP_IF_FALSE);
+  block(node.stmts);
+  emit_u16(OP_JUMP, start);
+  patch_jump(exit);
+}
+
+
+void Compiler::visit(ForStmt& node)
+{
+  // the bounds are kept in hidden slots (set by FOR_PREP, which skips
+  // the loop if it is empty) and the loop variable is a copy of the
+  // counter; FOR_LOOP steps the counter and jumps back to the body
+  push_scope();
+  node.start->accept(*this);
+  node.end->accept(*this);
+  int counter = hidden_slot(node.var_id);
+  hidden_slot(node.var_id);
+  mark(node.var_id);
+  int exit = emit_jump(OP_FOR_PREP);
+  fun().code.push_back(counter);
+  int body = offset();
+  push_scope();
+  emit_u8(OP_LOAD, counter);
+  emit_u8(OP_STORE, declare(node.var_id.lexeme(), node.var_id));
+  block(node.stmts);
+  pop_scope();
+  emit_u16(OP_FOR_LOOP, body);
+  fun().code.push_back(counter);
+  patch_jump(exit);
+  pop_scope();
+}
+
+
+//----------------------------------------------------------------------
+// Expression Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Compiler::visit(Expr& node)
+{
+  node.first->accept(*this);
+  if (node.op) {
+    TokenType t = node.op->type();
+    // and/or short circuit on the (boolean) left operand
+    if (t == AND or t == OR) {
+      mark(*node.op);
+      int end = emit_jump(t == AND ? OP_JUMP_IF_FALSE_OR_POP : OP_JUMP_IF_TRUE_OR_POP);
+      node.rest->accept(*this);
+      patch_jump(end);
+    }
+    else {
+      node.rest->accept(*this);
+      mark(*node.op);
+      switch(t) {
+        case PLUS: emit(OP_ADD); break;
+        case MINUS: emit(OP_SUB); break;
+        case MULTIPLY: emit(OP_MUL); break;
+        case DIVIDE: emit(OP_DIV); break;
+        case MODULO: emit(OP_MOD); break;
+        case EQUAL: emit(OP_EQ); break;
+        case NOT_EQUAL: emit(OP_NE); break;
+        case LESS: emit(OP_LT); break;
+        case LESS_EQUAL: emit(OP_LE); break;
+        case GREATER: emit(OP_GT); break;
+        default: emit(OP_GE); break;
+      }
+    }
+  }
+  if (node.negated)
+    emit(OP_NOT);
+}
+
+
+void Compiler::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+
+void Compiler::visit(ComplexTerm& node)
+{
+  node.expr->accept(*this);
+}
+
+
+//----------------------------------------------------------------------
+// RValue Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Compiler::visit(SimpleRValue& node)
+{
+  Value val = Runtime::literal(node.value);
+  if (val.is_nil())
+    emit(OP_NIL);
+  else if (val.is_bool())
+    emit(val.as_bool() ? OP_TRUE : OP_FALSE);
+  else
+    emit_u16(OP_CONST, add_constant(val));
+}
+
+
+void Compiler::visit(NewRValue& node)
+{
+  auto t = type_ids.find(node.type_id.lexeme());
+  if (t == type_ids.end()) {
+    emit_error("undefined type '" + node.type_id.lexeme() + "'", node.type_id);
+    return;
+  }
+  emit_u16(OP_NEW, t->second);
+}
+
+
+void Compiler::visit(CallExpr& node)
+{
+  // user functions take precedence over built-ins, and the arguments
+  // are evaluated before a call error is raised
+  const std::string& name = node.function_id.lexeme();
+  for (Expr* e : node.arg_list)
+    e->accept(*this);
+  int argc = node.arg_list.size();
+  auto f = function_ids.find(name);
+  int builtin = Runtime::builtin_id(name);
+  if (f != function_ids.end()) {
+    if (module.functions[f->second].param_count != argc) {
+      emit_error("wrong number of arguments to '" + name + "'", node.function_id);
+      return;
+    }
+    mark(node.function_id);
+    emit_u16(OP_CALL, f->second);
+  }
+  else if (builtin >= 0) {
+    mark(node.function_id);
+    emit_u16(OP_BUILTIN, builtin);
+  }
+  else {
+    emit_error("undefined function '" + name + "'", node.function_id);
+    return;
+  }
+  fun().code.push_back(argc);
+}
+
+
+void Compiler::visit(IDRValue& node)
+{
+  const Token& root = node.path.front();
+  int slot = lookup(root.lexeme());
+  if (slot < 0) {
+    emit_error("undefined variable '" + root.lexeme() + "'", root);
+    return;
+  }
+  emit_u8(OP_LOAD, slot);
+  for (auto it = ++node.path.begin(); it != node.path.end(); ++it) {
+    mark(*it);
+    emit_u16(OP_GETFIELD, add_name(it->lexeme()));
+  }
+}
+
+
+void Compiler::visit(NegatedRValue& node)
+{
+  node.expr->accept(*this);
+  emit(OP_NEG);
+}
+
+
+#endif
@@ -0,0 +1,86 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: data_object.h
+// DATE: 10/19/2026
+// DESC: Runtime values for the AST interpreter. A data object holds
+//       exactly one MyPL value (nil, int, double, bool, char, string,
+//       or an object id referring to the interpreter heap).
+//----------------------------------------------------------------------
+
+#ifndef DATA_OBJECT_H
+#define DATA_OBJECT_H
+
+#include <string>
+#include <sstream>
+
+
+// the kinds of values a data object can hold
+enum DataType {NIL_DATA, INT_DATA, DOUBLE_DATA, BOOL_DATA, CHAR_DATA,
+               STRING_DATA, OID_DATA};
+
+
+class DataObject
+{
+public:
+  // construct a nil value
+  DataObject() : data_type(NIL_DATA) {}
+
+  // setters (overwrite the current value)
+  void set_nil() {data_type = NIL_DATA;}
+  void set(int v) {data_type = INT_DATA; int_val = v;}
+  void set(double v) {data_type = DOUBLE_DATA; double_val = v;}
+  void set(bool v) {data_type = BOOL_DATA; bool_val = v;}
+  void set(char v) {data_type = CHAR_DATA; char_val = v;}
+  void set(const std::string& v) {data_type = STRING_DATA; string_val = v;}
+  void set_oid(int v) {data_type = OID_DATA; int_val = v;}
+
+  // type tests
+  DataType type() const {return data_type;}
+  bool is_nil() const {return data_type == NIL_DATA;}
+  bool is_int() const {return data_type == INT_DATA;}
+  bool is_double() const {return data_type == DOUBLE_DATA;}
+  bool is_bool() const {return data_type == BOOL_DATA;}
+  bool is_char() const {return data_type == CHAR_DATA;}
+  bool is_string() const {return data_type == STRING_DATA;}
+  bool is_oid() const {return data_type == OID_DATA;}
+
+  // getters (caller must check the type first)
+  int int_value() const {return int_val;}
+  double double_value() const {return double_val;}
+  bool bool_value() const {return bool_val;}
+  char char_value() const {return char_val;}
+  const std::string& string_value() const {return string_val;}
+  int oid_value() const {return int_val;}
+
+  // string representation (as printed by the print builtin)
+  std::string to_string() const;
+
+private:
+  DataType data_type;
+  int int_val = 0;
+  double double_val = 0.0;
+  bool bool_val = false;
+  char char_val = '\0';
+  std::string string_val;
+};
+
+
+std::string DataObject::to_string() const
+{
+  switch(data_type) {
+    case INT_DATA: return std::to_string(int_val);
+    case DOUBLE_DATA: {
+      std::ostringstream s;
+      s << double_val;
+      return s.str();
+    }
+    case BOOL_DATA: return bool_val ? "true" : "false";
+    case CHAR_DATA: return std::string(1, char_val);
+    case STRING_DATA: return string_val;
+    case OID_DATA: return "<" + std::to_string(int_val) + ">";
+    default: return "nil";
+  }
+}
+
+
+#endif
@@ -0,0 +1,193 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: escape.h
+// DATE: 10/19/2026
+// DESC: Escape analysis for the compilers. Finds the variables of a
+//       function declared with a new object (var x = new T) whose
+//       object cannot outlive the call: the variable is only ever the
+//       base of field accesses (x.f or x.f = e), so its value is never
+//       stored, passed, returned, compared, or assigned over, and no
+//       other reference to the object can exist. Such objects can be
+//       allocated in the function's frame instead of the object heap.
+//----------------------------------------------------------------------
+
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "ast.h"
+
+
+class EscapeAnalysis : public Visitor
+{
+public:
+  // the declarations in the function whose objects do not escape
+  static std::unordered_set<const VarDeclStmt*> local_objects(FunDecl& fun);
+
+  // top-level
+  void visit(Program&) {}
+  void visit(FunDecl& node);
+  void visit(TypeDecl&) {}
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node) {node.expr->accept(*this);}
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node) {node.rvalue->accept(*this);}
+  void visit(ComplexTerm& node) {node.expr->accept(*this);}
+  // rvalues
+  void visit(SimpleRValue&) {}
+  void visit(NewRValue&) {}
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node) {node.expr->accept(*this);}
+
+private:
+  // the declaration each visible name is bound to (null if it is not
+  // a new object's), scoped as the compilers scope variables
+  std::vector<std::unordered_map<std::string,const VarDeclStmt*>> scopes;
+  std::unordered_set<const VarDeclStmt*> candidates;
+  std::unordered_set<const VarDeclStmt*> escaping;
+
+  void escape(const std::string& name);
+  void block(std::list<Stmt*>& stmts);
+  static bool is_new(Expr& expr);
+};
+
+
+std::unordered_set<const VarDeclStmt*> EscapeAnalysis::local_objects(FunDecl& fun)
+{
+  EscapeAnalysis analysis;
+  fun.accept(analysis);
+  std::unordered_set<const VarDeclStmt*> locals;
+  for (const VarDeclStmt* v : analysis.candidates)
+    if (not analysis.escaping.count(v))
+      locals.insert(v);
+  return locals;
+}
+
+
+// the object of the variable the name refers to (if any) escapes
+void EscapeAnalysis::escape(const std::string& name)
+{
+  for (size_t i = scopes.size(); i > 0; --i) {
+    auto it = scopes[i-1].find(name);
+    if (it != scopes[i-1].end()) {
+      if (it->second)
+        escaping.insert(it->second);
+      return;
+    }
+  }
+}
+
+
+void EscapeAnalysis::block(std::list<Stmt*>& stmts)
+{
+  scopes.emplace_back();
+  for (Stmt* s : stmts)
+    s->accept(*this);
+  scopes.pop_back();
+}
+
+
+// true if the expression is a lone new
+bool EscapeAnalysis::is_new(Expr& expr)
+{
+  SimpleTerm* term = dynamic_cast<SimpleTerm*>(expr.first);
+  return not expr.op and not expr.negated and term and
+    dynamic_cast<NewRValue*>(term->rvalue);
+}
+
+
+void EscapeAnalysis::visit(FunDecl& node)
+{
+  scopes.emplace_back();
+  for (FunDecl::FunParam& p : node.params)
+    scopes.back()[p.id.lexeme()] = nullptr;
+  block(node.stmts);
+  scopes.pop_back();
+}
+
+
+void EscapeAnalysis::visit(VarDeclStmt& node)
+{
+  node.expr->accept(*this);
+  const VarDeclStmt* decl = is_new(*node.expr) ? &node : nullptr;
+  scopes.back()[node.id.lexeme()] = decl;
+  if (decl)
+    candidates.insert(decl);
+}
+
+
+// (assigning over a variable counts as an escape, so a variable holds
+// its own object for as long as it is in scope)
+void EscapeAnalysis::visit(AssignStmt& node)
+{
+  node.expr->accept(*this);
+  if (node.lvalue_list.size() == 1)
+    escape(node.lvalue_list.front().lexeme());
+}
+
+
+void EscapeAnalysis::visit(IfStmt& node)
+{
+  node.if_part->expr->accept(*this);
+  block(node.if_part->stmts);
+  for (BasicIf* part : node.else_ifs) {
+    part->expr->accept(*this);
+    block(part->stmts);
+  }
+  block(node.body_stmts);
+}
+
+
+void EscapeAnalysis::visit(WhileStmt& node)
+{
+  node.expr->accept(*this);
+  block(node.stmts);
+}
+
+
+void EscapeAnalysis::visit(ForStmt& node)
+{
+  node.start->accept(*this);
+  node.end->accept(*this);
+  scopes.emplace_back();
+  scopes.back()[node.var_id.lexeme()] = nullptr;
+  block(node.stmts);
+  scopes.pop_back();
+}
+
+
+void EscapeAnalysis::visit(Expr& node)
+{
+  node.first->accept(*this);
+  if (node.rest)
+    node.rest->accept(*this);
+}
+
+
+void EscapeAnalysis::visit(CallExpr& node)
+{
+  for (Expr* e : node.arg_list)
+    e->accept(*this);
+}
+
+
+// (a variable used as a whole is an escape, as the base of a path it
+// is not)
+void EscapeAnalysis::visit(IDRValue& node)
+{
+  if (node.path.size() == 1)
+    escape(node.path.front().lexeme());
+}
+
+
+#endif
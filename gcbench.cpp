@@ -0,0 +1,144 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: gcbench.cpp
+// DATE: 10/19/2026
+// DESC: Collector benchmarks on heaps of Node objects (an int and a
+//       next field). The scaling benchmark builds lists of 1000 nodes
+//       (10 million nodes by default, or the number given), drops
+//       every other list, and times a full collection marking and
+//       sweeping on 1, 2, 4, 8, and 16 threads (each with a freshly
+//       built heap), reporting the speedup over one thread. The
+//       pointer chasing benchmark builds lists with their nodes
+//       scattered among each other's (as if built a node at a time in
+//       random order) and times walking them before and after a
+//       compacting collection.
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include "heap.h"
+
+using namespace std;
+
+
+const int LIST_LENGTH = 1000;
+const int thread_counts[] = {1, 2, 4, 8, 16};
+const int CHASE_LISTS = 64;
+const int CHASE_WALKS = 3;
+
+
+// the heads of the lists kept
+class Lists : public RootSource
+{
+public:
+  vector<Value> heads;
+  void mark_roots(Heap& heap) {for (Value& v : heads) heap.visit(v);}
+};
+
+
+// a new node in front of a list (old, as there are no roots yet)
+Value push(Heap& heap, int val, const Value& head)
+{
+  Object* node = heap.allocate(0, 2);
+  heap.store(node, 0, Value::from_int(val));
+  heap.store(node, 1, head);
+  return Value::from_object(node);
+}
+
+
+// build the lists, then keep half
+void build(Heap& heap, Lists& lists, long nodes)
+{
+  for (long n = 0; n < nodes; n += LIST_LENGTH) {
+    Value head;
+    for (int i = 0; i < LIST_LENGTH; ++i)
+      head = push(heap, i, head);
+    if ((n / LIST_LENGTH) % 2 == 0)
+      lists.heads.push_back(head);
+  }
+  heap.set_roots(&lists);
+}
+
+
+void scaling(long nodes)
+{
+  cout << "collection: " << nodes << " nodes, half of them live" << endl
+       << setw(8) << "threads" << setw(12) << "mark (ms)" << setw(12) << "sweep (ms)"
+       << setw(12) << "total (ms)" << setw(10) << "speedup" << endl;
+  double base = 0;
+  for (int threads : thread_counts) {
+    Heap heap;
+    Lists lists;
+    build(heap, lists, nodes);
+    heap.set_gc_threads(threads);
+    heap.collect();
+    const HeapStats& s = heap.stats();
+    double total = s.mark_time + s.sweep_time;
+    if (threads == 1)
+      base = total;
+    cout << fixed << setprecision(1) << setw(8) << threads << setw(12) << s.mark_time
+         << setw(12) << s.sweep_time << setw(12) << total
+         << setprecision(2) << setw(10) << base / total << endl;
+    heap.set_roots(nullptr);
+  }
+}
+
+
+// the sum of the lists' values, and the time (in milliseconds) to walk
+// them CHASE_WALKS times
+long walk(const Lists& lists, double& ms)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  long sum = 0;
+  for (int w = 0; w < CHASE_WALKS; ++w) {
+    for (const Value& head : lists.heads) {
+      for (Value node = head; node.is_object(); node = node.as_object()->fields()[1])
+        sum += node.as_object()->fields()[0].as_int();
+    }
+  }
+  ms = chrono::duration<double,milli>(chrono::steady_clock::now() - start).count();
+  return sum;
+}
+
+
+void chasing(long nodes)
+{
+  Heap heap;
+  Lists lists;
+  lists.heads.resize(CHASE_LISTS);
+  mt19937 random(1);
+  for (long n = 0; n < nodes; ++n) {
+    Value& head = lists.heads[random() % CHASE_LISTS];
+    head = push(heap, n % LIST_LENGTH, head);
+  }
+  heap.set_roots(&lists);
+  double before, after;
+  long sum = walk(lists, before);
+  heap.set_compacting(true);
+  heap.collect();
+  bool same = walk(lists, after) == sum;
+  double hops = (double)nodes * CHASE_WALKS;
+  cout << "pointer chasing: " << nodes << " nodes in " << CHASE_LISTS << " lists, "
+       << CHASE_WALKS << " walks" << endl
+       << setw(16) << "" << setw(12) << "walk (ms)" << setw(12) << "ns per hop" << endl
+       << fixed << setprecision(1)
+       << setw(16) << "scattered" << setw(12) << before << setw(12) << before * 1e6 / hops << endl
+       << setw(16) << "compacted" << setw(12) << after << setw(12) << after * 1e6 / hops
+       << (same ? "" : "  (sums differ!)") << endl
+       << setprecision(2) << "speedup " << before / after << endl;
+  heap.set_roots(nullptr);
+}
+
+
+int main(int argc, char* argv[])
+{
+  long nodes = argc > 1 ? atol(argv[1]) : 10000000;
+  scaling(nodes);
+  cout << endl;
+  chasing(nodes);
+}
@@ -0,0 +1,1366 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: heap.h
+// DATE: 10/19/2026
+// DESC: Garbage-collected heap for MyPL struct objects, in two
+//       generations. New objects are bump-allocated in a nursery, and
+//       a minor collection copies the ones still reachable (from the
+//       roots, or from old objects through dirty cards) out to the old
+//       generation. The old generation is made of pages of equal-size
+//       cells (one size class per page, large objects get a page of
+//       their own), reclaimed by a precise, non-moving mark-sweep
+//       collector: the engine running the program visits the values
+//       in its stack slots (its roots, see RootSource), marking
+//       follows object fields, and sweeping frees every unmarked cell.
+//       Each page keeps its allocation and mark bits in bitmaps in its
+//       header, apart from the objects, so sweeping and finding free
+//       cells read a few words per page. Storing a young object in an
+//       old one marks the old object's card (see store).
+//       With a pause target, major collections mark incrementally: the
+//       roots are marked when one starts and the rest in steps at each
+//       minor collection (or on a background thread), while stores
+//       mark the old objects they overwrite (a snapshot-at-the-
+//       beginning barrier), so every object reachable when marking
+//       started is marked, and objects allocated since are black.
+//       The rest of a major collection can run on several threads:
+//       marking with work stealing, and sweeping in chunks of pages.
+//       Major collections can compact instead, moving the live old
+//       objects to new pages in depth-first order along their fields
+//       (so lists and trees are laid out in the order they are walked).
+//       The runtime registers each type with the heap, which gives it
+//       a size class of exactly its objects' size (types have a fixed
+//       number of fields), counts the objects allocated by type, and
+//       can take a census of the heap by type and by size class.
+//----------------------------------------------------------------------
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "mypl_exception.h"
+#include "value.h"
+
+
+// marking on more than one thread needs atomic mark bits (GCC/Clang
+// builtins), and marking on a background thread also needs fields
+// read in one load (NaN-boxed values)
+#ifndef MYPL_ATOMIC_MARKS
+#if defined(__GNUC__)
+#define MYPL_ATOMIC_MARKS 1
+#else
+#define MYPL_ATOMIC_MARKS 0
+#endif
+#endif
+
+#ifndef MYPL_BACKGROUND_MARK
+#if MYPL_ATOMIC_MARKS and not MYPL_FAT_VALUES
+#define MYPL_BACKGROUND_MARK 1
+#else
+#define MYPL_BACKGROUND_MARK 0
+#endif
+#endif
+
+
+class Heap;
+
+
+// something holding values that can reference objects (an engine's
+// stack), visited at the start of each collection (young objects move,
+// so the values are updated)
+class RootSource
+{
+public:
+  virtual ~RootSource() {}
+  virtual void mark_roots(Heap& heap) = 0;
+};
+
+
+// upper bounds (in milliseconds) of the pause histogram's buckets but
+// the last
+const int PAUSE_BUCKETS = 10;
+const double pause_bounds[PAUSE_BUCKETS - 1] = {0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50};
+
+
+// collector statistics (pauses in milliseconds, sizes in bytes; the
+// major pauses are the parts of pauses spent on major collections, of
+// which mark_time was spent marking all that was left gray at once and
+// sweep_time sweeping, and pauses counts every pause by length)
+struct HeapStats
+{
+  long collections = 0;
+  long compactions = 0;
+  double total_pause = 0;
+  double max_pause = 0;
+  long mark_steps = 0;
+  double background_mark = 0;
+  double mark_time = 0;
+  double sweep_time = 0;
+  long pauses[PAUSE_BUCKETS] = {};
+  long minor_collections = 0;
+  double minor_pause = 0;
+  double max_minor_pause = 0;
+  size_t bytes_promoted = 0;
+  size_t bytes_allocated = 0;
+  size_t bytes_reclaimed = 0;
+  long objects_reclaimed = 0;
+  size_t peak_committed = 0;
+};
+
+
+// the objects in the heap by type (with the bytes of their cells, and
+// how much of them is rounding up to the cell size) and the old cells
+// by size class (where the unused cells of the pages are fragmentation)
+struct HeapCensus
+{
+  struct Type
+  {
+    long allocations = 0;
+    long objects = 0;
+    size_t bytes = 0;
+    size_t wasted = 0;
+  };
+  struct SizeClass
+  {
+    size_t cell_size = 0;
+    size_t pages = 0;
+    size_t cells = 0;
+    size_t used = 0;
+  };
+  std::vector<Type> types;
+  std::vector<SizeClass> classes;
+};
+
+
+class Heap
+{
+public:
+  Heap();
+  ~Heap();
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+
+  // a new object with nil fields (collecting first if the nursery is
+  // full or enough has been promoted since the last major collection)
+  Object* allocate(int type_id, int field_count);
+
+  // register a type whose objects have field_count fields (given the
+  // next id, from 0), and allocate one of its objects (counted by type)
+  int add_type(int field_count);
+  Object* allocate(int type_id)
+    {++type_allocations[type_id]; return allocate(type_id, type_fields[type_id]);}
+
+  // store val in obj's field i, through the write barrier (which marks
+  // obj's card if val is young and obj is old, records the objects
+  // holding strings, released when the objects die, and marks the
+  // overwritten object while marking)
+  void store(Object* obj, int i, const Value& val);
+
+  // set an object's fields from values (through the write barrier)
+  void copy_fields(Object* obj, const std::vector<Value>& values);
+
+  // the values to mark as roots (no collections happen without them,
+  // and changing them finishes an incremental collection)
+  void set_roots(RootSource* source);
+
+  // the most memory the nursery and the live old objects may take (0
+  // for no limit)
+  void set_limit(size_t bytes) {limit = bytes;}
+
+  // mark incrementally in steps of about ms milliseconds (0 to run
+  // major collections all at once)
+  void set_pause_target(double ms) {pause_target = ms;}
+
+  // mark on a background thread instead of in steps (with a pause
+  // target, where supported, see MYPL_BACKGROUND_MARK)
+  void set_background_marking(bool on) {background = on and MYPL_BACKGROUND_MARK;}
+
+  // mark and sweep on n threads (the calling one and n - 1 more)
+  void set_gc_threads(int n) {gc_threads = std::max(1, n);}
+
+  // compact in major collections (which then run all at once, on one
+  // thread) instead of sweeping
+  void set_compacting(bool on) {compacting = on;}
+
+  // run a full (minor and major) collection now
+  void collect();
+
+  // a root or field value: marks its object as reachable, or in a minor
+  // collection (or compaction) moves it and updates val
+  void visit(Value& val);
+
+  // bytes in allocated cells, and in the pages holding them
+  size_t bytes_in_use() const {return in_use;}
+  size_t bytes_committed() const {return committed;}
+  const HeapStats& stats() const {return heap_stats;}
+
+  // the objects (young and old) and old cells in the heap now
+  HeapCensus census() const;
+
+private:
+  static const size_t PAGE_SIZE = 1 << 16;
+  static const size_t MIN_CELL = 16;
+  static const size_t MAX_CELL = 2048;
+  static const size_t BITMAP_WORDS = PAGE_SIZE / MIN_CELL / 64;
+  static const size_t MIN_THRESHOLD = 1 << 20;
+  static const size_t NURSERY_SIZE = 1 << 22;
+  static const size_t CARD_SIZE = 512;
+  static const int FORWARDED = -1;
+  static const size_t MARK_STEP = 256;
+  static const size_t MAX_SPARE_PAGES = 64;
+  static const size_t PARALLEL_MIN = 1 << 22;
+  static const size_t SHARE_MIN = 64;
+  static const size_t SWEEP_CHUNK = 16;
+  typedef std::chrono::steady_clock Clock;
+
+  // a block of PAGE_SIZE (or a multiple, for a large object) aligned
+  // to PAGE_SIZE, starting with this header
+  struct Page
+  {
+    size_t cell_size;
+    size_t cell_count;
+    size_t live;
+    size_t bytes;
+    char* cells;
+    uint64_t alloc_bits[BITMAP_WORDS];
+    uint64_t mark_bits[BITMAP_WORDS];
+    uint8_t cards[PAGE_SIZE / CARD_SIZE];
+    // a bit per 16 bytes for the objects that may hold strings (the
+    // only fields to release when an object is freed)
+    uint64_t string_bits[PAGE_SIZE / 16 / 64];
+  };
+
+  // the pages of one cell size, and where to look for a free cell
+  struct SizeClass
+  {
+    size_t cell_size;
+    std::vector<Page*> pages;
+    size_t page_cursor = 0;
+    size_t word_cursor = 0;
+  };
+
+  std::vector<SizeClass> classes;
+  std::vector<int> class_of;
+  std::vector<Page*> large_pages;
+  std::vector<void*> spare_pages;
+  std::vector<Object*> mark_stack;
+  std::vector<Object*> promoted;
+  size_t promoted_count = 0;
+  RootSource* roots = nullptr;
+  bool minor = false;
+  std::vector<int> type_fields;
+  std::vector<long> type_allocations;
+
+  // major collections compact (evacuating while the live objects are
+  // moved, with the fields left to move on the stack)
+  bool compacting = false;
+  bool evacuating = false;
+  std::vector<Value*> evacuate_stack;
+
+  // an incremental major collection is marking (concurrent while the
+  // background thread runs, when the mutator logs the objects it marks
+  // for the thread, see shade)
+  bool marking = false;
+  double pause_target = 0;
+  bool background = false;
+  bool concurrent = false;
+  std::thread marker;
+  std::mutex log_lock;
+  std::vector<Object*> satb_log;
+  std::atomic<bool> marker_done{false};
+  double marker_time = 0;
+
+  // marking and sweeping threads (mark bits are set atomically while
+  // more than one thread marks)
+  int gc_threads = 1;
+  bool atomic_marks = false;
+
+  // a marking thread's gray objects, and the surplus it shares with
+  // the others (which steal from it when they run out)
+  struct MarkWorker
+  {
+    std::vector<Object*> gray;
+    std::mutex lock;
+    std::vector<Object*> shared;
+    std::atomic<size_t> shared_count{0};
+  };
+
+  // what a sweeping thread freed (and the objects it found holding
+  // strings, released after sweeping)
+  struct SweepResult
+  {
+    size_t freed = 0;
+    long objects = 0;
+    std::vector<Object*> strings;
+  };
+
+  // the nursery (allocated when there are first roots), its objects
+  // that may hold strings and a bit per 16 bytes marking them
+  char* nursery = nullptr;
+  char* nursery_top = nullptr;
+  char* nursery_end = nullptr;
+  size_t nursery_size = 0;
+  std::vector<Object*> young_strings;
+  std::vector<uint64_t> young_string_bits;
+
+  size_t limit = 0;
+  size_t in_use = 0;
+  size_t committed = 0;
+  size_t allocated_since = 0;
+  size_t threshold = MIN_THRESHOLD;
+  HeapStats heap_stats;
+
+  // helper functions
+  static size_t object_size(int field_count);
+  static size_t cell_bytes(int field_count);
+  void index_classes();
+  static Page* page_of(Object* obj)
+    {return (Page*)((uintptr_t)obj & ~(uintptr_t)(PAGE_SIZE - 1));}
+  bool young(Object* obj) const
+    {return (uintptr_t)obj - (uintptr_t)nursery < nursery_size;}
+  bool over_limit(size_t extra) const
+    {return limit and in_use + nursery_size + extra > limit;}
+  static double since(Clock::time_point start)
+    {return std::chrono::duration<double,std::milli>(Clock::now() - start).count();}
+  static int lowest_bit(uint64_t bits);
+  static int bit_count(uint64_t bits);
+  Page* new_page(size_t cell_size, size_t bytes);
+  void free_page(Page* page);
+  char* find_cell(SizeClass& c);
+  char* claim(Page* page, size_t i);
+  char* allocate_old(size_t size, size_t& cell_size, bool may_collect);
+  char* allocate_young(size_t size);
+  void remember_strings(Object* obj);
+  Object* promote(Object* obj);
+  void scan_cards(Page* page);
+  void collect_young();
+  void minor_collect();
+  void major_collect();
+  void start_marking(Clock::time_point start);
+  void mark_step(Clock::time_point start);
+  void finish_marking();
+  void background_mark(std::vector<Object*> gray);
+  bool set_mark(Object* obj);
+  void mark_object(Object* obj);
+  void shade(Object* obj);
+  void scan_gray(std::vector<Object*>& gray, size_t budget);
+  void mark_all(std::vector<Object*>& gray);
+  void mark_worker(std::vector<MarkWorker>& workers, int id, std::atomic<int>& idle);
+  bool steal(MarkWorker& from, MarkWorker& to);
+  void sweep_page(Page* page, SweepResult& result);
+  void release_empty(std::vector<Page*>& pages);
+  void sweep_all();
+  void compact();
+  void evacuate(Value& root);
+  Object* relocate(Object* obj);
+  void record_pause(double ms, double major_ms);
+  static void free_cell(Page* page, size_t i);
+  static void destroy(Object* obj);
+};
+
+
+inline void Heap::store(Object* obj, int i, const Value& val)
+{
+  Value& field = obj->fields()[i];
+  if (marking and field.is_object() and not young(field.as_object()))
+    shade(field.as_object());
+  if (val.is_object()) {
+    if (young(val.as_object()) and not young(obj)) {
+      Page* page = page_of(obj);
+      page->cards[((char*)obj - (char*)page) / CARD_SIZE] = 1;
+    }
+  }
+  else if (val.is_string())
+    remember_strings(obj);
+  field = val;
+}
+
+
+Heap::Heap()
+{
+  // classes every 16 bytes to 128, then 4 per doubling (and one per
+  // type size, see add_type)
+  size_t step = 16;
+  for (size_t size = MIN_CELL; size <= MAX_CELL; size += step) {
+    classes.emplace_back();
+    classes.back().cell_size = size;
+    if (size >= 128 and (size & (size - 1)) == 0)
+      step = size / 4;
+  }
+  index_classes();
+}
+
+
+// map sizes (in steps of 8 bytes) to the smallest class that fits
+void Heap::index_classes()
+{
+  class_of.clear();
+  for (size_t i = 0, c = 0; i <= MAX_CELL / 8; ++i) {
+    while (classes[c].cell_size < i * 8)
+      ++c;
+    class_of.push_back(c);
+  }
+}
+
+
+Heap::~Heap()
+{
+  if (concurrent)
+    marker.join();
+  for (Object* obj : young_strings)
+    if (obj->type_id != FORWARDED)
+      destroy(obj);
+  if (nursery) {
+    committed -= nursery_size;
+    std::free(nursery);
+  }
+  for (SizeClass& c : classes)
+    for (Page* page : c.pages)
+      free_page(page);
+  for (Page* page : large_pages)
+    free_page(page);
+  for (void* block : spare_pages)
+    std::free(block);
+}
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+size_t Heap::object_size(int field_count)
+{
+  return sizeof(Object) + field_count * sizeof(Value);
+}
+
+
+// the smallest cell for an object, in steps of 8 bytes (with room for a
+// forwarding pointer, and at least 16 apart, so each starts in its own
+// 16 bytes, see string_bits)
+size_t Heap::cell_bytes(int field_count)
+{
+  return std::max((size_t)MIN_CELL, (object_size(field_count) + 7) & ~(size_t)7);
+}
+
+
+int Heap::lowest_bit(uint64_t bits)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(bits);
+#else
+  int i = 0;
+  while (not (bits & 1)) {
+    bits >>= 1;
+    ++i;
+  }
+  return i;
+#endif
+}
+
+
+int Heap::bit_count(uint64_t bits)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(bits);
+#else
+  int n = 0;
+  for (; bits; bits &= bits - 1)
+    ++n;
+  return n;
+#endif
+}
+
+
+Heap::Page* Heap::new_page(size_t cell_size, size_t bytes)
+{
+  void* block = nullptr;
+  if (bytes == PAGE_SIZE and spare_pages.size()) {
+    block = spare_pages.back();
+    spare_pages.pop_back();
+    committed -= bytes;
+  }
+  else if (posix_memalign(&block, PAGE_SIZE, bytes) != 0)
+    throw MyPLException(RUNTIME, "out of memory", 0, 0);
+  Page* page = new (block) Page;
+  size_t header = (sizeof(Page) + 15) & ~(size_t)15;
+  page->cell_size = cell_size;
+  page->cell_count = cell_size > MAX_CELL ? 1 : (bytes - header) / cell_size;
+  page->live = 0;
+  page->bytes = bytes;
+  page->cells = (char*)block + header;
+  std::memset(page->alloc_bits, 0, sizeof(page->alloc_bits));
+  std::memset(page->mark_bits, 0, sizeof(page->mark_bits));
+  std::memset(page->cards, 0, sizeof(page->cards));
+  std::memset(page->string_bits, 0, sizeof(page->string_bits));
+  committed += bytes;
+  heap_stats.peak_committed = std::max(heap_stats.peak_committed, committed);
+  return page;
+}
+
+
+// free a page and the objects left in it (keeping a few pages spare,
+// still committed, as releasing memory can take a system call)
+void Heap::free_page(Page* page)
+{
+  for (size_t w = 0; w < BITMAP_WORDS; ++w)
+    for (uint64_t bits = page->alloc_bits[w]; bits; bits &= bits - 1)
+      free_cell(page, w * 64 + lowest_bit(bits));
+  if (page->bytes == PAGE_SIZE and spare_pages.size() < MAX_SPARE_PAGES) {
+    spare_pages.push_back(page);
+    return;
+  }
+  committed -= page->bytes;
+  std::free(page);
+}
+
+
+char* Heap::claim(Page* page, size_t i)
+{
+  page->alloc_bits[i / 64] |= 1ull << (i % 64);
+  ++page->live;
+  return page->cells + i * page->cell_size;
+}
+
+
+// the first free cell in the class's pages from its cursor (null if
+// they are full)
+char* Heap::find_cell(SizeClass& c)
+{
+  for (; c.page_cursor < c.pages.size(); ++c.page_cursor, c.word_cursor = 0) {
+    Page* page = c.pages[c.page_cursor];
+    if (page->live == page->cell_count)
+      continue;
+    size_t words = (page->cell_count + 63) / 64;
+    for (; c.word_cursor < words; ++c.word_cursor) {
+      uint64_t free = ~page->alloc_bits[c.word_cursor];
+      if (free) {
+        size_t i = c.word_cursor * 64 + lowest_bit(free);
+        if (i < page->cell_count)
+          return claim(page, i);
+      }
+    }
+  }
+  return nullptr;
+}
+
+
+// release the strings of the object in a page's cell i, if it may
+// hold any (without reading other objects)
+void Heap::free_cell(Page* page, size_t i)
+{
+  char* cell = page->cells + i * page->cell_size;
+  size_t g = (cell - (char*)page) / 16;
+  uint64_t bit = 1ull << (g % 64);
+  if (page->string_bits[g / 64] & bit) {
+    page->string_bits[g / 64] &= ~bit;
+    destroy((Object*)cell);
+  }
+}
+
+
+void Heap::destroy(Object* obj)
+{
+  Value* fields = obj->fields();
+  for (int i = 0; i < obj->field_count; ++i)
+    fields[i].~Value();
+}
+
+
+//----------------------------------------------------------------------
+// Allocation
+//----------------------------------------------------------------------
+
+
+// a cell of the old generation for an object of size bytes, sets
+// cell_size (may_collect is false during a minor collection, which
+// goes over the limit if it must, see allocate_young)
+char* Heap::allocate_old(size_t size, size_t& cell_size, bool may_collect)
+{
+  if (may_collect and roots and allocated_since >= threshold and not marking)
+    collect();
+  bool large = size > MAX_CELL;
+  SizeClass* c = large ? nullptr : &classes[class_of[(size + 7) / 8]];
+  cell_size = large ? size : c->cell_size;
+  if (may_collect and over_limit(cell_size)) {
+    if (roots)
+      collect();
+    if (over_limit(cell_size))
+      throw MyPLException(RUNTIME, "out of memory (heap limit of " +
+                          std::to_string(limit) + " bytes)", 0, 0);
+  }
+  char* cell = large ? nullptr : find_cell(*c);
+  if (not cell) {
+    size_t header = (sizeof(Page) + 15) & ~(size_t)15;
+    size_t bytes = large ? (header + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1) : PAGE_SIZE;
+    Page* page = new_page(cell_size, bytes);
+    (large ? large_pages : c->pages).push_back(page);
+    cell = claim(page, 0);
+  }
+  in_use += cell_size;
+  allocated_since += cell_size;
+  // (objects allocated while marking are black)
+  if (marking)
+    set_mark((Object*)cell);
+  return cell;
+}
+
+
+// a cell of the nursery (after a minor collection if it is full)
+char* Heap::allocate_young(size_t size)
+{
+  if (not nursery) {
+    // a nursery of at most an eighth of the limit
+    nursery_size = NURSERY_SIZE;
+    if (limit)
+      nursery_size = std::max((size_t)PAGE_SIZE, std::min(nursery_size, limit / 8 & ~(size_t)15));
+    if (posix_memalign((void**)&nursery, PAGE_SIZE, nursery_size) != 0)
+      throw MyPLException(RUNTIME, "out of memory", 0, 0);
+    nursery_top = nursery;
+    nursery_end = nursery + nursery_size;
+    young_string_bits.assign(nursery_size / 16 / 64, 0);
+    committed += nursery_size;
+    heap_stats.peak_committed = std::max(heap_stats.peak_committed, committed);
+  }
+  if ((size_t)(nursery_end - nursery_top) < size)
+    collect_young();
+  char* cell = nursery_top;
+  nursery_top += size;
+  return cell;
+}
+
+
+Object* Heap::allocate(int type_id, int field_count)
+{
+  // objects too big for a size class start out old (as do all objects
+  // when there are no roots to collect the nursery with)
+  size_t size = cell_bytes(field_count);
+  size_t cell_size = size;
+  char* cell = roots and size <= MAX_CELL ? allocate_young(size)
+                                          : allocate_old(size, cell_size, true);
+  heap_stats.bytes_allocated += cell_size;
+  Object* obj = (Object*)cell;
+  obj->type_id = type_id;
+  obj->field_count = field_count;
+  Value* fields = obj->fields();
+  for (int i = 0; i < field_count; ++i)
+    new (fields + i) Value();
+  return obj;
+}
+
+
+// (a class for the type's size is added if there is none)
+int Heap::add_type(int field_count)
+{
+  size_t size = cell_bytes(field_count);
+  if (size <= MAX_CELL and classes[class_of[size / 8]].cell_size != size) {
+    SizeClass c;
+    c.cell_size = size;
+    classes.insert(classes.begin() + class_of[size / 8], c);
+    index_classes();
+  }
+  type_fields.push_back(field_count);
+  type_allocations.push_back(0);
+  return type_fields.size() - 1;
+}
+
+
+void Heap::copy_fields(Object* obj, const std::vector<Value>& values)
+{
+  for (size_t i = 0; i < values.size(); ++i)
+    store(obj, i, values[i]);
+}
+
+
+// note that an object may hold strings
+void Heap::remember_strings(Object* obj)
+{
+  if (not young(obj)) {
+    Page* page = page_of(obj);
+    size_t g = ((char*)obj - (char*)page) / 16;
+    page->string_bits[g / 64] |= 1ull << (g % 64);
+    return;
+  }
+  size_t i = ((char*)obj - nursery) / 16;
+  uint64_t bit = 1ull << (i % 64);
+  if (young_string_bits[i / 64] & bit)
+    return;
+  young_string_bits[i / 64] |= bit;
+  young_strings.push_back(obj);
+}
+
+
+HeapCensus Heap::census() const
+{
+  HeapCensus census;
+  census.types.resize(type_fields.size());
+  for (size_t i = 0; i < type_fields.size(); ++i)
+    census.types[i].allocations = type_allocations[i];
+  auto count = [&](const Object* obj, size_t cell_size) {
+    if ((size_t)obj->type_id >= census.types.size())
+      return;
+    HeapCensus::Type& t = census.types[obj->type_id];
+    ++t.objects;
+    t.bytes += cell_size;
+    t.wasted += cell_size - object_size(obj->field_count);
+  };
+  for (const SizeClass& c : classes) {
+    if (c.pages.empty())
+      continue;
+    HeapCensus::SizeClass k;
+    k.cell_size = c.cell_size;
+    k.pages = c.pages.size();
+    for (Page* page : c.pages) {
+      k.cells += page->cell_count;
+      k.used += page->live;
+      for (size_t w = 0; w < BITMAP_WORDS; ++w)
+        for (uint64_t bits = page->alloc_bits[w]; bits; bits &= bits - 1)
+          count((Object*)(page->cells + (w * 64 + lowest_bit(bits)) * page->cell_size),
+                page->cell_size);
+    }
+    census.classes.push_back(k);
+  }
+  for (Page* page : large_pages)
+    count((Object*)page->cells, page->cell_size);
+  for (char* p = nursery; p < nursery_top; ) {
+    const Object* obj = (const Object*)p;
+    size_t size = cell_bytes(obj->field_count);
+    count(obj, size);
+    p += size;
+  }
+  return census;
+}
+
+
+//----------------------------------------------------------------------
+// Collection
+//----------------------------------------------------------------------
+
+
+void Heap::set_roots(RootSource* source)
+{
+  if (marking)
+    finish_marking();
+  roots = source;
+}
+
+
+void Heap::visit(Value& val)
+{
+  if (not val.is_object())
+    return;
+  Object* obj = val.as_object();
+  if (minor) {
+    if (young(obj))
+      val = Value::from_object(promote(obj));
+  }
+  else if (evacuating)
+    evacuate(val);
+  else if (not young(obj))
+    mark_object(obj);
+}
+
+
+// set an object's mark bit (atomically while another thread marks),
+// true if it was not set
+bool Heap::set_mark(Object* obj)
+{
+  Page* page = page_of(obj);
+  size_t i = ((char*)obj - page->cells) / page->cell_size;
+  uint64_t bit = 1ull << (i % 64);
+  uint64_t& word = page->mark_bits[i / 64];
+#if MYPL_ATOMIC_MARKS
+  if (atomic_marks)
+    return not (__atomic_fetch_or(&word, bit, __ATOMIC_ACQ_REL) & bit);
+#endif
+  if (word & bit)
+    return false;
+  word |= bit;
+  return true;
+}
+
+
+void Heap::mark_object(Object* obj)
+{
+  if (set_mark(obj))
+    mark_stack.push_back(obj);
+}
+
+
+// mark an object overwritten while marking (logging it for the
+// background thread to scan while it runs)
+void Heap::shade(Object* obj)
+{
+  if (not concurrent)
+    mark_object(obj);
+  else if (set_mark(obj)) {
+    std::lock_guard<std::mutex> lock(log_lock);
+    satb_log.push_back(obj);
+  }
+}
+
+
+// scan up to budget gray objects, marking the old objects their fields
+// refer to (each field is read once, as the mutator may be storing to
+// it)
+void Heap::scan_gray(std::vector<Object*>& gray, size_t budget)
+{
+  for (; budget and not gray.empty(); --budget) {
+    Object* obj = gray.back();
+    gray.pop_back();
+    Value* fields = obj->fields();
+    for (int i = 0; i < obj->field_count; ++i) {
+      Object* ref = fields[i].load_object();
+      if (ref and not young(ref) and set_mark(ref))
+        gray.push_back(ref);
+    }
+  }
+}
+
+
+// the old copy of a young object (moving its fields there the first
+// time, leaving a forwarding pointer and queueing the copy to be
+// scanned)
+Object* Heap::promote(Object* obj)
+{
+  Object* copy;
+  if (obj->type_id == FORWARDED) {
+    std::memcpy(&copy, obj + 1, sizeof(copy));
+    return copy;
+  }
+  size_t cell_size;
+  copy = (Object*)allocate_old(object_size(obj->field_count), cell_size, false);
+  heap_stats.bytes_promoted += cell_size;
+  copy->type_id = obj->type_id;
+  copy->field_count = obj->field_count;
+  Value* from = obj->fields();
+  Value* to = copy->fields();
+  bool strings = false;
+  for (int i = 0; i < obj->field_count; ++i) {
+    strings = strings or from[i].is_string();
+    new (to + i) Value(std::move(from[i]));
+  }
+  if (strings)
+    remember_strings(copy);
+  obj->type_id = FORWARDED;
+  std::memcpy(obj + 1, &copy, sizeof(copy));
+  promoted.push_back(copy);
+  ++promoted_count;
+  return copy;
+}
+
+
+// visit the fields of the objects starting in the page's dirty cards
+// (and clear them)
+void Heap::scan_cards(Page* page)
+{
+  const size_t words = sizeof(page->cards) / 8;
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t dirty;
+    std::memcpy(&dirty, page->cards + w * 8, 8);
+    if (not dirty)
+      continue;
+    for (size_t card = w * 8; card < w * 8 + 8; ++card) {
+      if (not page->cards[card])
+        continue;
+      page->cards[card] = 0;
+      char* start = (char*)page + card * CARD_SIZE;
+      char* end = start + CARD_SIZE;
+      size_t i = start <= page->cells ? 0 :
+        (start - page->cells + page->cell_size - 1) / page->cell_size;
+      for (; i < page->cell_count and page->cells + i * page->cell_size < end; ++i) {
+        if (not (page->alloc_bits[i / 64] & (1ull << (i % 64))))
+          continue;
+        Object* obj = (Object*)(page->cells + i * page->cell_size);
+        Value* fields = obj->fields();
+        for (int f = 0; f < obj->field_count; ++f)
+          visit(fields[f]);
+      }
+    }
+  }
+}
+
+
+// the nursery is full: empty it, then start, continue or finish a major
+// collection as needed (a full one if the promoted objects went over
+// the limit, which is then out of memory if they still do)
+void Heap::collect_young()
+{
+  Clock::time_point start = Clock::now();
+  minor_collect();
+  double minor_ms = since(start);
+  bool major = marking or over_limit(0) or allocated_since >= threshold;
+  if (over_limit(0)) {
+    if (marking)
+      finish_marking();
+    major_collect();
+    if (over_limit(0))
+      throw MyPLException(RUNTIME, "out of memory (heap limit of " +
+                          std::to_string(limit) + " bytes)", 0, 0);
+  }
+  else if (marking and not concurrent)
+    mark_step(start);
+  else if (marking and marker_done)
+    finish_marking();
+  else if (not marking and allocated_since >= threshold) {
+    if (pause_target > 0 and not compacting)
+      start_marking(start);
+    else
+      major_collect();
+  }
+  double ms = since(start);
+  record_pause(ms, major ? ms - minor_ms : 0);
+}
+
+
+// copy the live young objects to the old generation, then empty the
+// nursery (releasing the strings held by the dead ones)
+void Heap::minor_collect()
+{
+  Clock::time_point start = Clock::now();
+  minor = true;
+  promoted_count = 0;
+  roots->mark_roots(*this);
+  // (promoting can add pages, which have no dirty cards)
+  for (SizeClass& c : classes)
+    for (size_t i = 0, n = c.pages.size(); i < n; ++i)
+      scan_cards(c.pages[i]);
+  for (Page* page : large_pages)
+    scan_cards(page);
+  while (not promoted.empty()) {
+    Object* obj = promoted.back();
+    promoted.pop_back();
+    Value* fields = obj->fields();
+    for (int i = 0; i < obj->field_count; ++i)
+      visit(fields[i]);
+  }
+  minor = false;
+  for (Object* obj : young_strings) {
+    if (obj->type_id != FORWARDED)
+      destroy(obj);
+    size_t i = ((char*)obj - nursery) / 16;
+    young_string_bits[i / 64] = 0;
+  }
+  young_strings.clear();
+  nursery_top = nursery;
+  double pause = since(start);
+  ++heap_stats.minor_collections;
+  heap_stats.minor_pause += pause;
+  heap_stats.max_minor_pause = std::max(heap_stats.max_minor_pause, pause);
+}
+
+
+// mark from the roots (after a minor collection), then mark the
+// snapshot's objects in steps, or start the background thread on them
+void Heap::start_marking(Clock::time_point start)
+{
+  marking = true;
+  allocated_since = 0;
+  roots->mark_roots(*this);
+  if (not background) {
+    mark_step(start);
+    return;
+  }
+  std::vector<Object*> gray;
+  gray.swap(mark_stack);
+  concurrent = atomic_marks = true;
+  marker_done = false;
+  marker = std::thread(&Heap::background_mark, this, std::move(gray));
+}
+
+
+// mark until the pause target (counted from start) is reached, but at
+// least twice as many objects as the minor collection promoted (so
+// marking finishes before the old generation has doubled), and finish
+// the collection if nothing is left gray
+void Heap::mark_step(Clock::time_point start)
+{
+  ++heap_stats.mark_steps;
+  size_t work = 2 * promoted_count + MARK_STEP;
+  while (not mark_stack.empty()) {
+    scan_gray(mark_stack, MARK_STEP);
+    work -= std::min(work, (size_t)MARK_STEP);
+    if (not work and since(start) >= pause_target)
+      return;
+  }
+  finish_marking();
+}
+
+
+// the background thread: mark the gray objects and those the mutator
+// logs until there are none left
+void Heap::background_mark(std::vector<Object*> gray)
+{
+  Clock::time_point start = Clock::now();
+  while (true) {
+    scan_gray(gray, SIZE_MAX);
+    std::lock_guard<std::mutex> lock(log_lock);
+    if (satb_log.empty())
+      break;
+    gray.swap(satb_log);
+  }
+  marker_time = since(start);
+  marker_done = true;
+}
+
+
+// mark what is left (on the mutator, after joining the background
+// thread) and sweep
+void Heap::finish_marking()
+{
+  if (concurrent) {
+    marker.join();
+    concurrent = atomic_marks = false;
+    heap_stats.background_mark += marker_time;
+    mark_stack.insert(mark_stack.end(), satb_log.begin(), satb_log.end());
+    satb_log.clear();
+  }
+  mark_all(mark_stack);
+  marking = false;
+  sweep_all();
+}
+
+
+// mark from the gray objects until none are left, on gc_threads
+// threads if the heap is big enough to be worth it
+void Heap::mark_all(std::vector<Object*>& gray)
+{
+  Clock::time_point start = Clock::now();
+  int n = MYPL_ATOMIC_MARKS and in_use >= PARALLEL_MIN ? gc_threads : 1;
+  if (n == 1)
+    scan_gray(gray, SIZE_MAX);
+  else {
+    std::vector<MarkWorker> workers(n);
+    for (size_t i = 0; i < gray.size(); ++i)
+      workers[i % n].gray.push_back(gray[i]);
+    gray.clear();
+    std::atomic<int> idle(0);
+    atomic_marks = true;
+    std::vector<std::thread> threads;
+    for (int i = 1; i < n; ++i)
+      threads.emplace_back(&Heap::mark_worker, this, std::ref(workers), i, std::ref(idle));
+    mark_worker(workers, 0, idle);
+    for (std::thread& t : threads)
+      t.join();
+    atomic_marks = false;
+  }
+  heap_stats.mark_time += since(start);
+}
+
+
+// a marking thread: scan its gray objects (sharing half when it has
+// enough and its shared ones have been taken), then take back its
+// shared ones or steal another's, and when there are none anywhere wait
+// until all threads are idle (or one shares more)
+void Heap::mark_worker(std::vector<MarkWorker>& workers, int id, std::atomic<int>& idle)
+{
+  MarkWorker& self = workers[id];
+  int n = workers.size();
+  while (true) {
+    while (not self.gray.empty()) {
+      Object* obj = self.gray.back();
+      self.gray.pop_back();
+      Value* fields = obj->fields();
+      for (int i = 0; i < obj->field_count; ++i) {
+        Object* ref = fields[i].load_object();
+        if (ref and not young(ref) and set_mark(ref))
+          self.gray.push_back(ref);
+      }
+      if (self.gray.size() >= SHARE_MIN and self.shared_count == 0) {
+        std::lock_guard<std::mutex> lock(self.lock);
+        size_t half = self.gray.size() / 2;
+        self.shared.assign(self.gray.begin(), self.gray.begin() + half);
+        self.gray.erase(self.gray.begin(), self.gray.begin() + half);
+        self.shared_count = half;
+      }
+    }
+    bool found = steal(self, self);
+    for (int k = 1; k < n and not found; ++k)
+      found = steal(workers[(id + k) % n], self);
+    if (found)
+      continue;
+    ++idle;
+    while (true) {
+      if (idle == n)
+        return;
+      bool shared = false;
+      for (MarkWorker& w : workers)
+        shared = shared or w.shared_count;
+      if (shared) {
+        --idle;
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+}
+
+
+// move half of from's shared gray objects (all of them if from is to)
+// to to's, false if it had none
+bool Heap::steal(MarkWorker& from, MarkWorker& to)
+{
+  if (from.shared_count == 0)
+    return false;
+  std::lock_guard<std::mutex> lock(from.lock);
+  size_t count = from.shared.size();
+  if (count == 0)
+    return false;
+  size_t take = &from == &to ? count : (count + 1) / 2;
+  to.gray.insert(to.gray.end(), from.shared.end() - take, from.shared.end());
+  from.shared.resize(count - take);
+  from.shared_count = count - take;
+  return true;
+}
+
+
+// free a page's unmarked cells and clear its mark bits (the objects
+// holding strings are only recorded, as releasing strings is left to
+// one thread)
+void Heap::sweep_page(Page* page, SweepResult& result)
+{
+  size_t words = (page->cell_count + 63) / 64;
+  size_t live = 0;
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t dead = page->alloc_bits[w] & ~page->mark_bits[w];
+    for (; dead; dead &= dead - 1) {
+      char* cell = page->cells + (w * 64 + lowest_bit(dead)) * page->cell_size;
+      size_t g = (cell - (char*)page) / 16;
+      uint64_t bit = 1ull << (g % 64);
+      if (page->string_bits[g / 64] & bit) {
+        page->string_bits[g / 64] &= ~bit;
+        result.strings.push_back((Object*)cell);
+      }
+      ++result.objects;
+    }
+    page->alloc_bits[w] = page->mark_bits[w];
+    page->mark_bits[w] = 0;
+    live += bit_count(page->alloc_bits[w]);
+  }
+  result.freed += (page->live - live) * page->cell_size;
+  page->live = live;
+}
+
+
+// free the pages left empty
+void Heap::release_empty(std::vector<Page*>& pages)
+{
+  size_t kept = 0;
+  for (Page* page : pages) {
+    if (page->live == 0)
+      free_page(page);
+    else
+      pages[kept++] = page;
+  }
+  pages.resize(kept);
+}
+
+
+// sweep every page (on gc_threads threads taking chunks of pages, if
+// the heap is big enough to be worth it), ending a major collection
+// (the next once as much again as survived is promoted)
+void Heap::sweep_all()
+{
+  Clock::time_point start = Clock::now();
+  std::vector<Page*> pages(large_pages);
+  for (SizeClass& c : classes)
+    pages.insert(pages.end(), c.pages.begin(), c.pages.end());
+  int n = in_use >= PARALLEL_MIN ? gc_threads : 1;
+  std::vector<SweepResult> results(n);
+  std::atomic<size_t> next(0);
+  auto sweep_chunks = [&](int id) {
+    size_t first;
+    while ((first = next.fetch_add(SWEEP_CHUNK)) < pages.size())
+      for (size_t i = first; i < std::min(first + SWEEP_CHUNK, pages.size()); ++i)
+        sweep_page(pages[i], results[id]);
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < n; ++i)
+    threads.emplace_back(sweep_chunks, i);
+  sweep_chunks(0);
+  for (std::thread& t : threads)
+    t.join();
+  for (SweepResult& r : results) {
+    for (Object* obj : r.strings)
+      destroy(obj);
+    in_use -= r.freed;
+    heap_stats.bytes_reclaimed += r.freed;
+    heap_stats.objects_reclaimed += r.objects;
+  }
+  for (SizeClass& c : classes) {
+    release_empty(c.pages);
+    c.page_cursor = c.word_cursor = 0;
+  }
+  release_empty(large_pages);
+  threshold = std::max((size_t)MIN_THRESHOLD, in_use);
+  ++heap_stats.collections;
+  heap_stats.sweep_time += since(start);
+}
+
+
+// move the live old objects to new pages, each followed by what its
+// fields refer to in depth-first order from the roots, then free the
+// old pages (releasing the strings of the dead objects) and sweep the
+// large objects, which stay put (with the nursery empty)
+void Heap::compact()
+{
+  std::vector<Page*> from;
+  size_t from_bytes = 0;
+  long from_objects = 0;
+  for (SizeClass& c : classes) {
+    for (Page* page : c.pages) {
+      from_bytes += page->live * page->cell_size;
+      from_objects += page->live;
+    }
+    from.insert(from.end(), c.pages.begin(), c.pages.end());
+    c.pages.clear();
+    c.page_cursor = c.word_cursor = 0;
+  }
+  in_use -= from_bytes;
+  evacuating = true;
+  roots->mark_roots(*this);
+  evacuating = false;
+  allocated_since = 0;
+  size_t moved = 0;
+  long moved_objects = 0;
+  for (SizeClass& c : classes) {
+    for (Page* page : c.pages) {
+      moved += page->live * page->cell_size;
+      moved_objects += page->live;
+    }
+  }
+  for (Page* page : from)
+    free_page(page);
+  heap_stats.bytes_reclaimed += from_bytes - moved;
+  heap_stats.objects_reclaimed += from_objects - moved_objects;
+  SweepResult large;
+  for (Page* page : large_pages)
+    sweep_page(page, large);
+  for (Object* obj : large.strings)
+    destroy(obj);
+  in_use -= large.freed;
+  heap_stats.bytes_reclaimed += large.freed;
+  heap_stats.objects_reclaimed += large.objects;
+  release_empty(large_pages);
+  threshold = std::max((size_t)MIN_THRESHOLD, in_use);
+  ++heap_stats.collections;
+  ++heap_stats.compactions;
+}
+
+
+// move what a root refers to, then what its fields refer to and so on
+// (depth-first, each object's fields in order), updating the references
+void Heap::evacuate(Value& root)
+{
+  evacuate_stack.push_back(&root);
+  while (not evacuate_stack.empty()) {
+    Value* slot = evacuate_stack.back();
+    evacuate_stack.pop_back();
+    Object* obj = slot->as_object();
+    Object* copy = relocate(obj);
+    if (copy != obj)
+      *slot = Value::from_object(copy);
+  }
+}
+
+
+// the new place of an object (moving it the first time, leaving a
+// forwarding pointer, or marking it if it is large, and queueing its
+// fields to be moved next)
+Object* Heap::relocate(Object* obj)
+{
+  Object* copy;
+  if (obj->type_id == FORWARDED) {
+    std::memcpy(&copy, obj + 1, sizeof(copy));
+    return copy;
+  }
+  Page* page = page_of(obj);
+  if (page->cell_size > MAX_CELL) {
+    if (not set_mark(obj))
+      return obj;
+    copy = obj;
+  }
+  else {
+    size_t cell_size;
+    copy = (Object*)allocate_old(object_size(obj->field_count), cell_size, false);
+    copy->type_id = obj->type_id;
+    copy->field_count = obj->field_count;
+    Value* from = obj->fields();
+    Value* to = copy->fields();
+    for (int i = 0; i < obj->field_count; ++i)
+      new (to + i) Value(std::move(from[i]));
+    // (the strings are the copy's now, the forwarding pointer is no
+    // field to release)
+    size_t g = ((char*)obj - (char*)page) / 16;
+    uint64_t bit = 1ull << (g % 64);
+    if (page->string_bits[g / 64] & bit) {
+      page->string_bits[g / 64] &= ~bit;
+      remember_strings(copy);
+    }
+    obj->type_id = FORWARDED;
+    std::memcpy(obj + 1, &copy, sizeof(copy));
+  }
+  Value* fields = copy->fields();
+  for (int i = copy->field_count - 1; i >= 0; --i)
+    if (fields[i].is_object())
+      evacuate_stack.push_back(fields + i);
+  return copy;
+}
+
+
+// mark and sweep (or compact) the old generation all at once (with the
+// nursery empty)
+void Heap::major_collect()
+{
+  if (compacting) {
+    compact();
+    return;
+  }
+  allocated_since = 0;
+  roots->mark_roots(*this);
+  mark_all(mark_stack);
+  sweep_all();
+}
+
+
+// count a pause of ms milliseconds, major_ms of them on a major
+// collection
+void Heap::record_pause(double ms, double major_ms)
+{
+  int b = 0;
+  while (b < PAUSE_BUCKETS - 1 and ms >= pause_bounds[b])
+    ++b;
+  ++heap_stats.pauses[b];
+  heap_stats.total_pause += major_ms;
+  heap_stats.max_pause = std::max(heap_stats.max_pause, major_ms);
+}
+
+
+void Heap::collect()
+{
+  if (not roots)
+    return;
+  Clock::time_point start = Clock::now();
+  double minor_ms = 0;
+  if (nursery) {
+    minor_collect();
+    minor_ms = since(start);
+  }
+  if (marking)
+    finish_marking();
+  else
+    major_collect();
+  double ms = since(start);
+  record_pause(ms, ms - minor_ms);
+}
+
+
+#endif
@@ -0,0 +1,411 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: image.h
+// DATE: 10/19/2026
+// DESC: Precompiled bytecode images for the MyPL stack VM. An image
+//       holds a compiled module in a position-independent layout (all
+//       references are offsets from its start) that is mapped into
+//       memory as-is, so loading it does not parse, compile, or copy
+//       the code: functions point into the mapping and constants are
+//       materialized as the VM first uses them.
+//
+//       Layout (little-endian u32 fields, sections 4-byte aligned):
+//         header     magic "MYPLIMG\0", version, then the count and
+//                    offset of the constants, names, types, and
+//                    functions, and the total size
+//         strings    u32 length followed by its bytes (each distinct
+//                    string stored once)
+//         constants  {kind, low, high} (strings by string offset)
+//         names      string offset
+//         types      {name, init function, field count, fields
+//                    offset}, each field a name and its default
+//                    constant
+//         functions  {name, params, locals, code offset, code size,
+//                    positions offset, position count}
+//         code and positions (positions as 3 i32s each)
+//----------------------------------------------------------------------
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mypl_exception.h"
+#include "value.h"
+#include "bytecode.h"
+
+
+const char IMAGE_MAGIC[8] = {'M', 'Y', 'P', 'L', 'I', 'M', 'G', '\0'};
+const uint32_t IMAGE_VERSION = 2;
+
+// header fields (u32 indexes after the magic)
+enum ImageHeader {
+  IH_VERSION, IH_CONSTANT_COUNT, IH_CONSTANTS, IH_NAME_COUNT, IH_NAMES,
+  IH_TYPE_COUNT, IH_TYPES, IH_FUNCTION_COUNT, IH_FUNCTIONS, IH_SIZE,
+  IH_FIELD_COUNT
+};
+
+const uint32_t IMAGE_HEADER_SIZE = 8 + 4 * IH_FIELD_COUNT;
+const uint32_t IMAGE_CONSTANT_SIZE = 12;
+const uint32_t IMAGE_TYPE_SIZE = 16;
+const uint32_t IMAGE_FIELD_SIZE = 4 + IMAGE_CONSTANT_SIZE;
+const uint32_t IMAGE_FUNCTION_SIZE = 28;
+
+
+//----------------------------------------------------------------------
+// Writing
+//----------------------------------------------------------------------
+
+
+class ImageWriter
+{
+public:
+  ImageWriter(const Module& image_module) : module(image_module) {}
+
+  // lay out the module's image and write it to out
+  void write(std::ostream& out);
+
+private:
+  const Module& module;
+  std::vector<uint8_t> data;
+  std::unordered_map<std::string,uint32_t> strings;
+
+  uint32_t reserve(uint32_t size);
+  void put_u32(uint32_t offset, uint32_t v);
+  uint32_t string(const std::string& s);
+  void put_constant(uint32_t offset, const Value& val);
+};
+
+
+void write_image(const Module& module, std::ostream& out)
+{
+  ImageWriter(module).write(out);
+}
+
+
+// append size zeroed bytes (keeping sections 4-byte aligned) and
+// return their offset
+uint32_t ImageWriter::reserve(uint32_t size)
+{
+  uint32_t offset = data.size();
+  data.resize(offset + ((size + 3) & ~3u));
+  return offset;
+}
+
+
+void ImageWriter::put_u32(uint32_t offset, uint32_t v)
+{
+  for (int i = 0; i < 4; ++i)
+    data[offset + i] = (v >> (8 * i)) & 0xFF;
+}
+
+
+// the offset of the (interned) string s
+uint32_t ImageWriter::string(const std::string& s)
+{
+  auto it = strings.find(s);
+  if (it != strings.end())
+    return it->second;
+  uint32_t offset = reserve(4 + s.size());
+  put_u32(offset, s.size());
+  std::memcpy(&data[offset + 4], s.data(), s.size());
+  strings[s] = offset;
+  return offset;
+}
+
+
+void ImageWriter::put_constant(uint32_t offset, const Value& val)
+{
+  uint64_t bits = 0;
+  switch(val.kind()) {
+    case V_INT: bits = (uint32_t)val.as_int(); break;
+    case V_DOUBLE: {
+      double d = val.as_double();
+      std::memcpy(&bits, &d, sizeof(d));
+      break;
+    }
+    case V_BOOL: bits = val.as_bool(); break;
+    case V_CHAR: bits = (unsigned char)val.as_char(); break;
+    case V_STRING: bits = string(val.as_string()); break;
+    default: break;
+  }
+  put_u32(offset, val.kind());
+  put_u32(offset + 4, bits & 0xFFFFFFFF);
+  put_u32(offset + 8, bits >> 32);
+}
+
+
+void ImageWriter::write(std::ostream& out)
+{
+  data.clear();
+  strings.clear();
+  reserve(IMAGE_HEADER_SIZE);
+  std::memcpy(&data[0], IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  // the tables (filled in below, as that adds strings)
+  uint32_t constants = reserve(IMAGE_CONSTANT_SIZE * module.constants.size());
+  uint32_t names = reserve(4 * module.names.size());
+  uint32_t types = reserve(IMAGE_TYPE_SIZE * module.types.size());
+  uint32_t functions = reserve(IMAGE_FUNCTION_SIZE * module.functions.size());
+  for (size_t i = 0; i < module.constants.size(); ++i)
+    put_constant(constants + IMAGE_CONSTANT_SIZE * i, module.constants[i]);
+  for (size_t i = 0; i < module.names.size(); ++i)
+    put_u32(names + 4 * i, string(module.names[i]));
+  for (size_t i = 0; i < module.types.size(); ++i) {
+    const TypeDef& t = module.types[i];
+    uint32_t fields = reserve(IMAGE_FIELD_SIZE * t.fields.size());
+    for (size_t j = 0; j < t.fields.size(); ++j) {
+      put_u32(fields + IMAGE_FIELD_SIZE * j, string(t.fields[j]));
+      put_constant(fields + IMAGE_FIELD_SIZE * j + 4, t.defaults[j]);
+    }
+    uint32_t entry = types + IMAGE_TYPE_SIZE * i;
+    put_u32(entry, string(t.name));
+    put_u32(entry + 4, t.init_function);
+    put_u32(entry + 8, t.fields.size());
+    put_u32(entry + 12, fields);
+  }
+  for (size_t i = 0; i < module.functions.size(); ++i) {
+    const Function& fun = module.functions[i];
+    uint32_t code = reserve(fun.size());
+    std::memcpy(&data[code], fun.bytes(), fun.size());
+    uint32_t positions = reserve(12 * fun.positions.size());
+    for (size_t j = 0; j < fun.positions.size(); ++j) {
+      const Position& p = fun.positions[j];
+      put_u32(positions + 12 * j, p.offset);
+      put_u32(positions + 12 * j + 4, p.line);
+      put_u32(positions + 12 * j + 8, p.column);
+    }
+    uint32_t entry = functions + IMAGE_FUNCTION_SIZE * i;
+    put_u32(entry, string(fun.name));
+    put_u32(entry + 4, fun.param_count);
+    put_u32(entry + 8, fun.local_count);
+    put_u32(entry + 12, code);
+    put_u32(entry + 16, fun.size());
+    put_u32(entry + 20, positions);
+    put_u32(entry + 24, fun.positions.size());
+  }
+  uint32_t header[IH_FIELD_COUNT] = {
+    IMAGE_VERSION, (uint32_t)module.constants.size(), constants,
+    (uint32_t)module.names.size(), names, (uint32_t)module.types.size(),
+    types, (uint32_t)module.functions.size(), functions,
+    (uint32_t)data.size()
+  };
+  for (int i = 0; i < IH_FIELD_COUNT; ++i)
+    put_u32(8 + 4 * i, header[i]);
+  out.write((const char*)data.data(), data.size());
+}
+
+
+//----------------------------------------------------------------------
+// Loading
+//----------------------------------------------------------------------
+
+
+class Image
+{
+public:
+  // map the image file at path (checking its layout)
+  Image(const std::string& path);
+  ~Image();
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+
+  // set up module to run the image: its types, names, and function
+  // table are read, its code and positions are left in the mapping
+  void load(Module& module) const;
+
+  // the module's constants (read from the image on demand)
+  int constant_count() const {return header(IH_CONSTANT_COUNT);}
+  Value constant(int k) const;
+
+private:
+  std::string path;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  uint32_t u32(uint32_t offset) const;
+  uint32_t header(ImageHeader field) const {return u32(8 + 4 * field);}
+  void check(bool ok) const;
+  void check_range(uint32_t offset, uint64_t length) const;
+  void check_string(uint32_t offset) const;
+  void check_constant(uint32_t offset) const;
+  std::string string(uint32_t offset) const;
+  Value constant_at(uint32_t offset) const;
+};
+
+
+Image::Image(const std::string& image_path)
+  : path(image_path)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw MyPLException(RUNTIME, "cannot open image '" + path + "'", 0, 0);
+  struct stat st;
+  if (fstat(fd, &st) == 0 and st.st_size > 0) {
+    size = st.st_size;
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    data = p == MAP_FAILED ? nullptr : (const uint8_t*)p;
+  }
+  close(fd);
+  if (not data) {
+    size = 0;
+    throw MyPLException(RUNTIME, "cannot map image '" + path + "'", 0, 0);
+  }
+  try {
+    check(size >= IMAGE_HEADER_SIZE and
+          std::memcmp(data, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0 and
+          header(IH_VERSION) == IMAGE_VERSION and header(IH_SIZE) == size);
+    // the tables (the code is checked as it is decoded)
+    uint32_t constants = header(IH_CONSTANTS);
+    check_range(constants, (uint64_t)IMAGE_CONSTANT_SIZE * constant_count());
+    for (int k = 0; k < constant_count(); ++k)
+      check_constant(constants + IMAGE_CONSTANT_SIZE * k);
+    uint32_t names = header(IH_NAMES);
+    check_range(names, 4ull * header(IH_NAME_COUNT));
+    for (uint32_t i = 0; i < header(IH_NAME_COUNT); ++i)
+      check_string(u32(names + 4 * i));
+    uint32_t functions = header(IH_FUNCTIONS), function_count = header(IH_FUNCTION_COUNT);
+    check_range(functions, (uint64_t)IMAGE_FUNCTION_SIZE * function_count);
+    for (uint32_t i = 0; i < function_count; ++i) {
+      uint32_t entry = functions + IMAGE_FUNCTION_SIZE * i;
+      check_string(u32(entry));
+      check(u32(entry + 16) > 0 and u32(entry + 4) <= u32(entry + 8));
+      check_range(u32(entry + 12), u32(entry + 16));
+      check_range(u32(entry + 20), 12ull * u32(entry + 24));
+      check(u32(entry + 20) % 4 == 0);
+    }
+    uint32_t types = header(IH_TYPES);
+    check_range(types, (uint64_t)IMAGE_TYPE_SIZE * header(IH_TYPE_COUNT));
+    for (uint32_t i = 0; i < header(IH_TYPE_COUNT); ++i) {
+      uint32_t entry = types + IMAGE_TYPE_SIZE * i;
+      check_string(u32(entry));
+      int init = u32(entry + 4);
+      check(init >= -1 and init < (int)function_count);
+      check_range(u32(entry + 12), (uint64_t)IMAGE_FIELD_SIZE * u32(entry + 8));
+      for (uint32_t j = 0; j < u32(entry + 8); ++j) {
+        check_string(u32(u32(entry + 12) + IMAGE_FIELD_SIZE * j));
+        check_constant(u32(entry + 12) + IMAGE_FIELD_SIZE * j + 4);
+      }
+    }
+  } catch (...) {
+    munmap((void*)data, size);
+    throw;
+  }
+}
+
+
+Image::~Image()
+{
+  munmap((void*)data, size);
+}
+
+
+uint32_t Image::u32(uint32_t offset) const
+{
+  const uint8_t* p = data + offset;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+void Image::check(bool ok) const
+{
+  if (not ok)
+    throw MyPLException(RUNTIME, "invalid image '" + path + "'", 0, 0);
+}
+
+
+void Image::check_range(uint32_t offset, uint64_t length) const
+{
+  check(offset >= IMAGE_HEADER_SIZE and offset + length <= size);
+}
+
+
+void Image::check_string(uint32_t offset) const
+{
+  check_range(offset, 4);
+  check_range(offset, 4ull + u32(offset));
+}
+
+
+void Image::check_constant(uint32_t offset) const
+{
+  check_range(offset, IMAGE_CONSTANT_SIZE);
+  uint32_t kind = u32(offset);
+  check(kind < V_OBJECT);
+  if (kind == V_STRING)
+    check_string(u32(offset + 4));
+}
+
+
+std::string Image::string(uint32_t offset) const
+{
+  return std::string((const char*)data + offset + 4, u32(offset));
+}
+
+
+Value Image::constant_at(uint32_t offset) const
+{
+  uint32_t lo = u32(offset + 4), hi = u32(offset + 8);
+  switch(u32(offset)) {
+    case V_INT: return Value::from_int(lo);
+    case V_DOUBLE: {
+      uint64_t bits = lo | (uint64_t)hi << 32;
+      double d;
+      std::memcpy(&d, &bits, sizeof(d));
+      return Value::from_double(d);
+    }
+    case V_BOOL: return Value::from_bool(lo);
+    case V_CHAR: return Value::from_char(lo);
+    case V_STRING: return Value::intern(string(lo));
+    default: return Value();
+  }
+}
+
+
+Value Image::constant(int k) const
+{
+  return constant_at(header(IH_CONSTANTS) + IMAGE_CONSTANT_SIZE * k);
+}
+
+
+void Image::load(Module& module) const
+{
+  module = Module();
+  module.image = this;
+  for (uint32_t i = 0; i < header(IH_NAME_COUNT); ++i)
+    module.names.push_back(string(u32(header(IH_NAMES) + 4 * i)));
+  for (uint32_t i = 0; i < header(IH_TYPE_COUNT); ++i) {
+    uint32_t entry = header(IH_TYPES) + IMAGE_TYPE_SIZE * i;
+    TypeDef t;
+    t.name = string(u32(entry));
+    t.init_function = (int)u32(entry + 4);
+    for (uint32_t j = 0; j < u32(entry + 8); ++j) {
+      uint32_t field = u32(entry + 12) + IMAGE_FIELD_SIZE * j;
+      t.fields.push_back(string(u32(field)));
+      t.defaults.push_back(constant_at(field + 4));
+    }
+    module.types.push_back(t);
+  }
+  module.functions.resize(header(IH_FUNCTION_COUNT));
+  for (size_t i = 0; i < module.functions.size(); ++i) {
+    uint32_t entry = header(IH_FUNCTIONS) + IMAGE_FUNCTION_SIZE * i;
+    Function& fun = module.functions[i];
+    fun.name = string(u32(entry));
+    fun.param_count = u32(entry + 4);
+    fun.local_count = u32(entry + 8);
+    fun.mapped_code = data + u32(entry + 12);
+    fun.mapped_code_size = u32(entry + 16);
+    fun.mapped_positions = (const Position*)(data + u32(entry + 20));
+    fun.mapped_position_count = u32(entry + 24);
+  }
+}
+
+
+#endif
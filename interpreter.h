@@ -0,0 +1,569 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: interpreter.h
+// DATE: 10/19/2026
+// DESC: Tree-walking interpreter for MyPL. Executes a program by
+//       visiting the AST directly, starting at main. This is the
+//       reference (correctness oracle) implementation that the
+//       faster execution engines are checked against.
+//----------------------------------------------------------------------
+
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include "lexer.h"
+#include "ast.h"
+#include "data_object.h"
+#include "symbol_table.h"
+
+
+// a struct instance created by new
+struct HeapObject
+{
+  std::string type_name;
+  std::unordered_map<std::string,DataObject> fields;
+};
+
+
+class Interpreter : public Visitor
+{
+public:
+  // constructor
+  Interpreter(std::ostream& output_stream) : out(output_stream) {}
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+  // number of statements executed so far (for benchmarking)
+  long stmt_count() const {return stmts_executed;}
+
+private:
+  std::ostream& out;
+
+  // declared functions and types
+  std::unordered_map<std::string,FunDecl*> functions;
+  std::unordered_map<std::string,TypeDecl*> types;
+
+  // variables, struct instances, and the next free object id
+  SymbolTable sym_table;
+  std::unordered_map<int,HeapObject> heap;
+  int next_oid = 1;
+
+  // result of the last evaluated expression
+  DataObject curr_val;
+  // set by a return statement until the enclosing call completes
+  bool returning = false;
+
+  long stmts_executed = 0;
+
+  // helper functions
+  void error(const std::string& msg, const Token& token);
+  void exec_stmts(std::list<Stmt*>& stmts);
+  void apply_op(const Token& op, const DataObject& lhs, DataObject& rhs);
+  bool compare(const Token& op, const DataObject& lhs, const DataObject& rhs);
+  bool condition(Expr& expr, const Token& token);
+  HeapObject& deref(const DataObject& val, const Token& token);
+  void call_builtin(CallExpr& node, std::vector<DataObject>& args);
+};
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+void Interpreter::error(const std::string& msg, const Token& token)
+{
+  throw MyPLException(RUNTIME, msg, token.line(), token.column());
+}
+
+
+void Interpreter::exec_stmts(std::list<Stmt*>& stmts)
+{
+  for (Stmt* s : stmts) {
+    ++stmts_executed;
+    s->accept(*this);
+    if (returning)
+      return;
+  }
+}
+
+
+bool Interpreter::condition(Expr& expr, const Token& token)
+{
+  expr.accept(*this);
+  if (not curr_val.is_bool())
+    error("expecting boolean condition", token);
+  return curr_val.bool_value();
+}
+
+
+HeapObject& Interpreter::deref(const DataObject& val, const Token& token)
+{
+  if (val.is_nil())
+    error("nil reference accessing '" + token.lexeme() + "'", token);
+  if (not val.is_oid())
+    error("'" + token.lexeme() + "' is not a field of a struct", token);
+  return heap[val.oid_value()];
+}
+
+
+bool Interpreter::compare(const Token& op, const DataObject& lhs,
+                          const DataObject& rhs)
+{
+  TokenType t = op.type();
+  // (in)equality is defined on any pair of values
+  if (t == EQUAL or t == NOT_EQUAL) {
+    bool same = lhs.type() == rhs.type();
+    if (same) {
+      switch(lhs.type()) {
+        case INT_DATA: same = lhs.int_value() == rhs.int_value(); break;
+        case DOUBLE_DATA: same = lhs.double_value() == rhs.double_value(); break;
+        case BOOL_DATA: same = lhs.bool_value() == rhs.bool_value(); break;
+        case CHAR_DATA: same = lhs.char_value() == rhs.char_value(); break;
+        case STRING_DATA: same = lhs.string_value() == rhs.string_value(); break;
+        case OID_DATA: same = lhs.oid_value() == rhs.oid_value(); break;
+        default: break;
+      }
+    }
+    return t == EQUAL ? same : not same;
+  }
+  // relational comparison requires matching primitive types
+  int c = 0;
+  if (lhs.is_int() and rhs.is_int())
+    c = (lhs.int_value() > rhs.int_value()) - (lhs.int_value() < rhs.int_value());
+  else if (lhs.is_double() and rhs.is_double())
+    c = (lhs.double_value() > rhs.double_value()) -
+      (lhs.double_value() < rhs.double_value());
+  else if (lhs.is_char() and rhs.is_char())
+    c = (lhs.char_value() > rhs.char_value()) - (lhs.char_value() < rhs.char_value());
+  else if (lhs.is_string() and rhs.is_string())
+    c = lhs.string_value().compare(rhs.string_value());
+  else
+    error("invalid operand types for '" + op.lexeme() + "'", op);
+  if (t == LESS) return c < 0;
+  if (t == LESS_EQUAL) return c <= 0;
+  if (t == GREATER) return c > 0;
+  return c >= 0;
+}
+
+
+// computes lhs op rhs, leaving the result in curr_val
+void Interpreter::apply_op(const Token& op, const DataObject& lhs, DataObject& rhs)
+{
+  TokenType t = op.type();
+  if (t == EQUAL or t == NOT_EQUAL or t == LESS or t == LESS_EQUAL or
+      t == GREATER or t == GREATER_EQUAL) {
+    curr_val.set(compare(op, lhs, rhs));
+    return;
+  }
+  // string concatenation
+  if (t == PLUS and (lhs.is_string() or lhs.is_char()) and
+      (rhs.is_string() or rhs.is_char())) {
+    curr_val.set(lhs.to_string() + rhs.to_string());
+    return;
+  }
+  if (lhs.is_int() and rhs.is_int()) {
+    // wrap on overflow (computed unsigned to stay well defined)
+    unsigned x = lhs.int_value(), y = rhs.int_value();
+    if ((t == DIVIDE or t == MODULO) and y == 0)
+      error("division by zero", op);
+    int r = 0;
+    switch(t) {
+      case PLUS: r = x + y; break;
+      case MINUS: r = x - y; break;
+      case MULTIPLY: r = x * y; break;
+      case DIVIDE: r = y == -1u ? 0u - x : lhs.int_value() / rhs.int_value(); break;
+      default: r = y == -1u ? 0 : lhs.int_value() % rhs.int_value(); break;
+    }
+    curr_val.set(r);
+  }
+  else if (lhs.is_double() and rhs.is_double() and t != MODULO) {
+    double x = lhs.double_value(), y = rhs.double_value();
+    switch(t) {
+      case PLUS: curr_val.set(x + y); break;
+      case MINUS: curr_val.set(x - y); break;
+      case MULTIPLY: curr_val.set(x * y); break;
+      default: curr_val.set(x / y); break;
+    }
+  }
+  else
+    error("invalid operand types for '" + op.lexeme() + "'", op);
+}
+
+
+//----------------------------------------------------------------------
+// Top-Level Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Interpreter::visit(Program& node)
+{
+  for (Decl* d : node.decls)
+    d->accept(*this);
+  if (not functions.count("main"))
+    throw MyPLException(RUNTIME, "undefined 'main' function", 0, 0);
+  // run main as a call without arguments
+  CallExpr main_call;
+  main_call.function_id = functions["main"]->id;
+  main_call.accept(*this);
+}
+
+
+void Interpreter::visit(FunDecl& node)
+{
+  functions[node.id.lexeme()] = &node;
+}
+
+
+void Interpreter::visit(TypeDecl& node)
+{
+  types[node.id.lexeme()] = &node;
+}
+
+
+//----------------------------------------------------------------------
+// Statement Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Interpreter::visit(VarDeclStmt& node)
+{
+  node.expr->accept(*this);
+  sym_table.add_name(node.id.lexeme(), curr_val);
+}
+
+
+void Interpreter::visit(AssignStmt& node)
+{
+  node.expr->accept(*this);
+  DataObject val = curr_val;
+  const Token& root = node.lvalue_list.front();
+  DataObject* var = sym_table.find(root.lexeme());
+  if (not var)
+    error("undefined variable '" + root.lexeme() + "'", root);
+  if (node.lvalue_list.size() == 1) {
+    *var = val;
+    return;
+  }
+  // follow the path to the struct holding the assigned field
+  DataObject obj = *var;
+  auto it = ++node.lvalue_list.begin();
+  for (; it != --node.lvalue_list.end(); ++it) {
+    HeapObject& h = deref(obj, *it);
+    auto f = h.fields.find(it->lexeme());
+    if (f == h.fields.end())
+      error("undefined field '" + it->lexeme() + "'", *it);
+    obj = f->second;
+  }
+  HeapObject& h = deref(obj, *it);
+  auto f = h.fields.find(it->lexeme());
+  if (f == h.fields.end())
+    error("undefined field '" + it->lexeme() + "'", *it);
+  f->second = val;
+}
+
+
+void Interpreter::visit(ReturnStmt& node)
+{
+  node.expr->accept(*this);
+  returning = true;
+}
+
+
+void Interpreter::visit(IfStmt& node)
+{
+  if (condition(*node.if_part->expr, Token())) {
+    sym_table.push_environment();
+    exec_stmts(node.if_part->stmts);
+    sym_table.pop_environment();
+    return;
+  }
+  for (BasicIf* else_if : node.else_ifs) {
+    if (condition(*else_if->expr, Token())) {
+      sym_table.push_environment();
+      exec_stmts(else_if->stmts);
+      sym_table.pop_environment();
+      return;
+    }
+  }
+  sym_table.push_environment();
+  exec_stmts(node.body_stmts);
+  sym_table.pop_environment();
+}
+
+
+void Interpreter::visit(WhileStmt& node)
+{
+  while (condition(*node.expr, Token())) {
+    sym_table.push_environment();
+    exec_stmts(node.stmts);
+    sym_table.pop_environment();
+    if (returning)
+      return;
+  }
+}
+
+
+void Interpreter::visit(ForStmt& node)
+{
+  // the bounds are evaluated once, and the loop variable is a copy of
+  // a hidden counter (assigning to it does not change the iteration)
+  node.start->accept(*this);
+  DataObject start = curr_val;
+  node.end->accept(*this);
+  DataObject end = curr_val;
+  if (not start.is_int() or not end.is_int())
+    error("expecting integer for loop bounds", node.var_id);
+  for (int i = start.int_value(); i <= end.int_value(); ++i) {
+    sym_table.push_environment();
+    DataObject var;
+    var.set(i);
+    sym_table.add_name(node.var_id.lexeme(), var);
+    exec_stmts(node.stmts);
+    sym_table.pop_environment();
+    if (returning or i == end.int_value())
+      return;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Expression Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Interpreter::visit(Expr& node)
+{
+  node.first->accept(*this);
+  if (node.op) {
+    TokenType t = node.op->type();
+    // and/or short circuit on the (boolean) left operand
+    if (t == AND or t == OR) {
+      if (not curr_val.is_bool())
+        error("expecting boolean operand for '" + node.op->lexeme() + "'",
+              *node.op);
+      if (curr_val.bool_value() == (t == AND))
+        node.rest->accept(*this);
+    }
+    else {
+      DataObject lhs = curr_val;
+      node.rest->accept(*this);
+      DataObject rhs = curr_val;
+      apply_op(*node.op, lhs, rhs);
+    }
+  }
+  if (node.negated) {
+    if (not curr_val.is_bool())
+      error("expecting boolean operand for 'not'", Token());
+    curr_val.set(not curr_val.bool_value());
+  }
+}
+
+
+void Interpreter::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+
+void Interpreter::visit(ComplexTerm& node)
+{
+  node.expr->accept(*this);
+}
+
+
+//----------------------------------------------------------------------
+// RValue Visitor Functions
+//----------------------------------------------------------------------
+
+
+void Interpreter::visit(SimpleRValue& node)
+{
+  const std::string& s = node.value.lexeme();
+  switch(node.value.type()) {
+    case INT_VAL: curr_val.set(std::stoi(s)); break;
+    case DOUBLE_VAL: curr_val.set(std::stod(s)); break;
+    case BOOL_VAL: curr_val.set(s == "true"); break;
+    case CHAR_VAL: curr_val.set(s[0]); break;
+    case STRING_VAL: curr_val.set(unescape(s)); break;
+    default: curr_val.set_nil(); break;
+  }
+}
+
+
+void Interpreter::visit(NewRValue& node)
+{
+  auto t = types.find(node.type_id.lexeme());
+  if (t == types.end())
+    error("undefined type '" + node.type_id.lexeme() + "'", node.type_id);
+  // field initializers only see their own (empty) frame
+  HeapObject obj;
+  obj.type_name = node.type_id.lexeme();
+  size_t base = sym_table.push_frame();
+  for (VarDeclStmt* v : t->second->vdecls) {
+    v->expr->accept(*this);
+    obj.fields[v->id.lexeme()] = curr_val;
+  }
+  sym_table.pop_frame(base);
+  int oid = next_oid++;
+  heap[oid] = obj;
+  curr_val.set_oid(oid);
+}
+
+
+void Interpreter::visit(CallExpr& node)
+{
+  std::vector<DataObject> args;
+  for (Expr* e : node.arg_list) {
+    e->accept(*this);
+    args.push_back(curr_val);
+  }
+  const std::string& name = node.function_id.lexeme();
+  auto f = functions.find(name);
+  if (f == functions.end()) {
+    call_builtin(node, args);
+    return;
+  }
+  FunDecl& fun = *f->second;
+  if (args.size() != fun.params.size())
+    error("wrong number of arguments to '" + name + "'", node.function_id);
+  size_t base = sym_table.push_frame();
+  size_t i = 0;
+  for (FunDecl::FunParam& p : fun.params)
+    sym_table.add_name(p.id.lexeme(), args[i++]);
+  curr_val.set_nil();
+  exec_stmts(fun.stmts);
+  if (not returning)
+    curr_val.set_nil();
+  returning = false;
+  sym_table.pop_frame(base);
+}
+
+
+void Interpreter::visit(IDRValue& node)
+{
+  const Token& root = node.path.front();
+  DataObject* var = sym_table.find(root.lexeme());
+  if (not var)
+    error("undefined variable '" + root.lexeme() + "'", root);
+  DataObject val = *var;
+  for (auto it = ++node.path.begin(); it != node.path.end(); ++it) {
+    HeapObject& h = deref(val, *it);
+    auto f = h.fields.find(it->lexeme());
+    if (f == h.fields.end())
+      error("undefined field '" + it->lexeme() + "'", *it);
+    val = f->second;
+  }
+  curr_val = val;
+}
+
+
+void Interpreter::visit(NegatedRValue& node)
+{
+  node.expr->accept(*this);
+  if (curr_val.is_int())
+    curr_val.set((int)(0u - (unsigned)curr_val.int_value()));
+  else if (curr_val.is_double())
+    curr_val.set(-curr_val.double_value());
+  else
+    error("expecting numeric operand for 'neg'", Token());
+}
+
+
+//----------------------------------------------------------------------
+// Built-In Functions
+//----------------------------------------------------------------------
+
+
+void Interpreter::call_builtin(CallExpr& node, std::vector<DataObject>& args)
+{
+  const Token& id = node.function_id;
+  const std::string& name = id.lexeme();
+  auto arity = [&](size_t n) {
+    if (args.size() != n)
+      error("wrong number of arguments to '" + name + "'", id);
+  };
+  if (name == "print") {
+    arity(1);
+    if (args[0].is_oid())
+      out << "<" << heap[args[0].oid_value()].type_name << ">";
+    else
+      out << args[0].to_string();
+    curr_val.set_nil();
+  }
+  else if (name == "read") {
+    arity(0);
+    std::string line;
+    std::getline(std::cin, line);
+    curr_val.set(line);
+  }
+  else if (name == "length") {
+    arity(1);
+    if (not args[0].is_string())
+      error("expecting string argument to 'length'", id);
+    curr_val.set((int)args[0].string_value().size());
+  }
+  else if (name == "get") {
+    arity(2);
+    if (not args[0].is_int() or not args[1].is_string())
+      error("expecting int and string arguments to 'get'", id);
+    const std::string& s = args[1].string_value();
+    int i = args[0].int_value();
+    if (i < 0 or i >= (int)s.size())
+      error("index out of range in 'get'", id);
+    curr_val.set(s[i]);
+  }
+  else if (name == "concat") {
+    arity(2);
+    if (not args[0].is_string() or not args[1].is_string())
+      error("expecting string arguments to 'concat'", id);
+    curr_val.set(args[0].string_value() + args[1].string_value());
+  }
+  else if (name == "itos" or name == "dtos") {
+    arity(1);
+    if (not (name == "itos" ? args[0].is_int() : args[0].is_double()))
+      error("invalid argument to '" + name + "'", id);
+    curr_val.set(args[0].to_string());
+  }
+  else if (name == "stoi" or name == "stod") {
+    arity(1);
+    if (not args[0].is_string())
+      error("expecting string argument to '" + name + "'", id);
+    try {
+      if (name == "stoi")
+        curr_val.set(std::stoi(args[0].string_value()));
+      else
+        curr_val.set(std::stod(args[0].string_value()));
+    } catch (std::exception&) {
+      error("invalid numeric string in '" + name + "'", id);
+    }
+  }
+  else
+    error("undefined function '" + name + "'", id);
+}
+
+
+#endif
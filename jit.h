@@ -0,0 +1,217 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: jit.h
+// DATE: 10/19/2026
+// DESC: Machine code support for the VM's baseline JIT (see vm.h): an
+//       assembler for the x86-64 instructions the JIT emits (with
+//       labels for jumps) and executable memory to hold the code, mapped
+//       writable to copy it in and then only executable. Only Linux on
+//       x86-64 with NaN-boxed values is supported (MYPL_JIT is 0
+//       elsewhere, and the VM just interprets).
+//----------------------------------------------------------------------
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <vector>
+#include <initializer_list>
+#include <cstdint>
+#include <cstring>
+#include "value.h"
+
+#ifndef MYPL_JIT
+#if defined(__x86_64__) and defined(__linux__) and not MYPL_FAT_VALUES
+#define MYPL_JIT 1
+#else
+#define MYPL_JIT 0
+#endif
+#endif
+
+#if MYPL_JIT
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mypl_exception.h"
+
+
+enum Reg {RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15};
+
+enum XmmReg {XMM0, XMM1};
+
+// condition codes (of jcc and setcc)
+enum Cond {
+  CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+  CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+// the ALU operations (their /digit for immediates, and their opcode
+// with a register source is 8 times it plus 1)
+enum AluOp {ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP};
+
+
+class Assembler
+{
+public:
+  std::vector<uint8_t> code;
+
+  // a jump target, bound to an offset in the code
+  typedef int Label;
+  Label new_label() {labels.push_back(-1); return labels.size() - 1;}
+  void bind(Label l) {labels[l] = code.size();}
+  int offset(Label l) const {return labels[l];}
+
+  // patch the jumps to their labels (all bound)
+  void resolve()
+  {
+    for (const Fixup& f : fixups) {
+      int32_t rel = labels[f.label] - (f.at + 4);
+      std::memcpy(&code[f.at], &rel, 4);
+    }
+    fixups.clear();
+  }
+
+  // moves (64-bit unless named otherwise; memory operands are a base
+  // register and a displacement)
+  void mov(Reg dst, Reg src) {op_rr(true, 0x89, src, dst);}
+  void mov(Reg dst, Reg base, int32_t disp) {op_rm(true, {0x8B}, dst, base, disp);}
+  void mov(Reg base, int32_t disp, Reg src) {op_rm(true, {0x89}, src, base, disp);}
+  void mov(Reg dst, uint64_t imm)
+  {
+    rex(true, 0, dst);
+    byte(0xB8 + (dst & 7));
+    bytes(&imm, 8);
+  }
+  void mov32(Reg dst, Reg base, int32_t disp) {op_rm(false, {0x8B}, dst, base, disp);}
+  void movzx8(Reg dst, Reg base, int32_t disp) {op_rm(false, {0x0F, 0xB6}, dst, base, disp);}
+  void movzx16(Reg dst, Reg base, int32_t disp) {op_rm(false, {0x0F, 0xB7}, dst, base, disp);}
+
+  // arithmetic
+  void alu(AluOp op, Reg dst, Reg src) {op_rr(true, op * 8 + 1, src, dst);}
+  void alu32(AluOp op, Reg dst, Reg src) {op_rr(false, op * 8 + 1, src, dst);}
+  void alu(AluOp op, Reg dst, int32_t imm) {alu_imm(true, op, dst, imm);}
+  void alu32(AluOp op, Reg dst, int32_t imm) {alu_imm(false, op, dst, imm);}
+  void imul32(Reg dst, Reg src) {rex(false, dst, src); byte(0x0F); byte(0xAF); modrm(dst, src);}
+  void neg32(Reg r) {rex(false, 0, r); byte(0xF7); modrm(3, r);}
+  void idiv32(Reg r) {rex(false, 0, r); byte(0xF7); modrm(7, r);}
+  void cdq() {byte(0x99);}
+  void shr(Reg r, uint8_t n) {rex(true, 0, r); byte(0xC1); modrm(5, r); byte(n);}
+  void shl(Reg r, uint8_t n) {rex(true, 0, r); byte(0xC1); modrm(4, r); byte(n);}
+  void test32(Reg a, Reg b) {op_rr(false, 0x85, b, a);}
+
+  // the low byte of a register (RAX to RBX) set to a condition, then
+  // zero extended
+  void setcc(Cond cc, Reg r)
+  {
+    byte(0x0F); byte(0x90 + cc); modrm(0, r);
+    byte(0x0F); byte(0xB6); modrm(r, r);
+  }
+
+  // jumps and calls
+  void jmp(Label l) {byte(0xE9); fixup(l);}
+  void jcc(Cond cc, Label l) {byte(0x0F); byte(0x80 + cc); fixup(l);}
+  void jmp(Reg r) {rex(false, 0, r); byte(0xFF); modrm(4, r);}
+  void call(Reg r) {rex(false, 0, r); byte(0xFF); modrm(2, r);}
+  void push(Reg r) {rex(false, 0, r); byte(0x50 + (r & 7));}
+  void pop(Reg r) {rex(false, 0, r); byte(0x58 + (r & 7));}
+  void ret() {byte(0xC3);}
+
+  // scalar doubles
+  void movq(XmmReg dst, Reg src) {byte(0x66); rex(true, dst, src); byte(0x0F); byte(0x6E); modrm(dst, src);}
+  void movq(Reg dst, XmmReg src) {byte(0x66); rex(true, src, dst); byte(0x0F); byte(0x7E); modrm(src, dst);}
+  void addsd(XmmReg dst, XmmReg src) {sse(0xF2, 0x58, dst, src);}
+  void mulsd(XmmReg dst, XmmReg src) {sse(0xF2, 0x59, dst, src);}
+  void subsd(XmmReg dst, XmmReg src) {sse(0xF2, 0x5C, dst, src);}
+  void divsd(XmmReg dst, XmmReg src) {sse(0xF2, 0x5E, dst, src);}
+  void ucomisd(XmmReg a, XmmReg b) {sse(0x66, 0x2E, a, b);}
+
+private:
+  struct Fixup
+  {
+    int at;
+    Label label;
+  };
+  std::vector<int> labels;
+  std::vector<Fixup> fixups;
+
+  void byte(uint8_t b) {code.push_back(b);}
+  void bytes(const void* p, size_t n)
+  {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    code.insert(code.end(), b, b + n);
+  }
+  void fixup(Label l)
+  {
+    Fixup f = {(int)code.size(), l};
+    fixups.push_back(f);
+    int32_t zero = 0;
+    bytes(&zero, 4);
+  }
+  // (a REX prefix only when needed: 64-bit, or a register past RDI)
+  void rex(bool wide, int reg, int rm)
+  {
+    uint8_t r = 0x40 | wide << 3 | (reg >> 3 & 1) << 2 | (rm >> 3 & 1);
+    if (r != 0x40)
+      byte(r);
+  }
+  void modrm(int reg, int rm) {byte(0xC0 | (reg & 7) << 3 | (rm & 7));}
+  void op_rr(bool wide, uint8_t op, int reg, int rm) {rex(wide, reg, rm); byte(op); modrm(reg, rm);}
+  // (always a 32-bit displacement, with the SIB byte RSP and R12 need)
+  void op_rm(bool wide, std::initializer_list<uint8_t> op, int reg, Reg base, int32_t disp)
+  {
+    rex(wide, reg, base);
+    for (uint8_t b : op)
+      byte(b);
+    byte(0x80 | (reg & 7) << 3 | (base & 7));
+    if ((base & 7) == RSP)
+      byte(0x24);
+    bytes(&disp, 4);
+  }
+  void alu_imm(bool wide, AluOp op, Reg r, int32_t imm)
+  {
+    rex(wide, 0, r);
+    byte(0x81);
+    modrm(op, r);
+    bytes(&imm, 4);
+  }
+  void sse(uint8_t prefix, uint8_t op, XmmReg dst, XmmReg src)
+  {
+    byte(prefix); byte(0x0F); byte(op); modrm(dst, src);
+  }
+};
+
+
+// a block of executable memory holding a copy of some code
+class ExecutableCode
+{
+public:
+  explicit ExecutableCode(const std::vector<uint8_t>& code)
+  {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size = (code.size() + page - 1) / page * page;
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      throw MyPLException(RUNTIME, "cannot map memory for compiled code", 0, 0);
+    std::memcpy(p, code.data(), code.size());
+    if (mprotect(p, size, PROT_READ | PROT_EXEC) != 0) {
+      munmap(p, size);
+      throw MyPLException(RUNTIME, "cannot make compiled code executable", 0, 0);
+    }
+    base = static_cast<uint8_t*>(p);
+  }
+  ~ExecutableCode() {munmap(base, size);}
+  ExecutableCode(const ExecutableCode&) = delete;
+  ExecutableCode& operator=(const ExecutableCode&) = delete;
+
+  const uint8_t* start() const {return base;}
+
+  // the code as a function of type F (starting at the first byte)
+  template<class F> F function() const {return reinterpret_cast<F>(base);}
+
+private:
+  uint8_t* base;
+  size_t size;
+};
+
+#endif
+
+#endif
@@ -342,4 +342,21 @@ Token Lexer::next_token()
 }
 
 
+// translate the escape sequences kept in a string literal's lexeme
+std::string unescape(const std::string& s)
+{
+  std::string r;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\\' and i + 1 < s.size()) {
+      char c = s[++i];
+      if (c == 'n') r += '\n';
+      else if (c == 't') r += '\t';
+      else r += c;
+    }
+    else r += s[i];
+  }
+  return r;
+}
+
+
 #endif
@@ -0,0 +1,247 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: mypl.cpp
+// DATE: 10/19/2026
+// DESC: Driver program for running MyPL programs. The execution
+//       engine is selected with -e (ast, closure, vm, or reg, default
+//       ast) and -d prints the program's bytecode (register code for
+//       -e reg) instead of running it, with -g keeping the names of
+//       local variables. -c FILE saves the program's bytecode to the
+//       image FILE instead, and -i FILE runs an image on the VM. For
+//       the engines with an object heap, -m KB limits its size, -p MS
+//       makes major collections incremental with a pause target of MS
+//       milliseconds (-b marking on a background thread instead), -t N
+//       marks and sweeps on N threads, -k compacts instead of sweeping,
+//       and -s prints its collector statistics after the run (with the
+//       objects allocated and left in the heap by type, and how full
+//       the pages of each size class are). On the VM, -r allocates
+//       objects in per-call regions (with -s also printing how many
+//       were, and how many escaped to the heap). A region is only
+//       freed when its call returns, so a long-running call's dead
+//       temporaries hold their space (up to 256 KB a call, then it
+//       allocates on the heap), though not what they refer to. -j
+//       compiles hot functions to machine code (with -s also printing
+//       how many).
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "interpreter.h"
+#include "runtime.h"
+#include "closure_compiler.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "vm.h"
+#include "image.h"
+#include "reg_bytecode.h"
+#include "reg_compiler.h"
+#include "reg_vm.h"
+
+using namespace std;
+
+
+// object heap options (-m, -p, -b, -t, -k and -s)
+size_t heap_limit = 0;
+double pause_target = 0;
+bool background_marking = false;
+int gc_threads = 1;
+bool compacting = false;
+bool heap_stats = false;
+
+// allocate the VM's objects in regions (-r), and compile its hot
+// functions (-j)
+bool use_regions = false;
+bool use_jit = false;
+
+
+Runtime& configure(Runtime& runtime)
+{
+  runtime.heap().set_limit(heap_limit);
+  runtime.heap().set_pause_target(pause_target);
+  runtime.heap().set_background_marking(background_marking);
+  runtime.heap().set_gc_threads(gc_threads);
+  runtime.heap().set_compacting(compacting);
+  return runtime;
+}
+
+
+void report(Runtime& runtime)
+{
+  if (not heap_stats)
+    return;
+  const HeapStats& s = runtime.heap().stats();
+  cerr << "minor collections: " << s.minor_collections << endl
+       << "minor pause (ms): total " << s.minor_pause << ", max " << s.max_minor_pause << endl
+       << "promoted (bytes): " << s.bytes_promoted << endl
+       << "major collections: " << s.collections << " (" << s.compactions
+       << " compacting, " << s.mark_steps
+       << " marking steps, " << s.background_mark << " ms marking in the background)" << endl
+       << "major pause (ms): total " << s.total_pause << ", max " << s.max_pause
+       << " (" << s.mark_time << " marking, " << s.sweep_time << " sweeping)" << endl
+       << "allocated (bytes): " << s.bytes_allocated << endl
+       << "reclaimed (bytes): " << s.bytes_reclaimed << " in "
+       << s.objects_reclaimed << " objects" << endl
+       << "peak heap (bytes): " << s.peak_committed << endl
+       << "pauses (ms):";
+  for (int i = 0; i < PAUSE_BUCKETS; ++i) {
+    if (i < PAUSE_BUCKETS - 1)
+      cerr << " <" << pause_bounds[i] << ": ";
+    else
+      cerr << " >=" << pause_bounds[i - 1] << ": ";
+    cerr << s.pauses[i];
+  }
+  cerr << endl;
+  HeapCensus census = runtime.heap().census();
+  cerr << "objects by type (allocated, in the heap, bytes, % wasted rounding up):" << endl;
+  for (size_t i = 0; i < census.types.size(); ++i) {
+    const HeapCensus::Type& t = census.types[i];
+    cerr << "  " << runtime.type(i).name << ": " << t.allocations << ", " << t.objects
+         << ", " << t.bytes << ", " << (t.bytes ? 100.0 * t.wasted / t.bytes : 0) << endl;
+  }
+  cerr << "old cells by size (pages, cells, % unused):" << endl;
+  for (const HeapCensus::SizeClass& c : census.classes)
+    cerr << "  " << c.cell_size << ": " << c.pages << ", " << c.cells << ", "
+         << 100.0 * (c.cells - c.used) / c.cells << endl;
+}
+
+
+// run a module on the VM, with the region and JIT options
+void run_vm(Runtime& runtime, const Module& module)
+{
+  VM vm(configure(runtime), module);
+  vm.use_regions(use_regions);
+  vm.use_jit(use_jit);
+  vm.run();
+  report(runtime);
+  if (heap_stats and use_regions)
+    cerr << "region objects: " << vm.region_objects() << " (" << vm.escaped_objects()
+         << " escaped to the heap)" << endl;
+  if (heap_stats and use_jit)
+    cerr << "compiled functions: " << vm.compiled_functions() << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+  // use standard input if no input file given
+  istream* input_stream = &cin;
+  string engine = "ast";
+  bool disassemble_only = false;
+  bool debug = false;
+  string image_out, image_in;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-e" and i + 1 < argc)
+      engine = argv[++i];
+    else if (arg == "-d")
+      disassemble_only = true;
+    else if (arg == "-g")
+      debug = true;
+    else if (arg == "-c" and i + 1 < argc)
+      image_out = argv[++i];
+    else if (arg == "-i" and i + 1 < argc)
+      image_in = argv[++i];
+    else if (arg == "-m" and i + 1 < argc)
+      heap_limit = stoul(argv[++i]) * 1024;
+    else if (arg == "-p" and i + 1 < argc)
+      pause_target = stod(argv[++i]);
+    else if (arg == "-b")
+      background_marking = true;
+    else if (arg == "-t" and i + 1 < argc)
+      gc_threads = stoi(argv[++i]);
+    else if (arg == "-k")
+      compacting = true;
+    else if (arg == "-s")
+      heap_stats = true;
+    else if (arg == "-r")
+      use_regions = true;
+    else if (arg == "-j")
+      use_jit = true;
+    else
+      input_stream = new ifstream(arg);
+  }
+
+  // run a precompiled image (without parsing)
+  if (image_in.size()) {
+    try {
+      Image image(image_in);
+      Module module;
+      image.load(module);
+      Runtime runtime(cout);
+      run_vm(runtime, module);
+    } catch (MyPLException e) {
+      cout << e.to_string() << endl;
+      exit(1);
+    }
+    return 0;
+  }
+
+  // create the lexer and parser
+  Lexer lexer(*input_stream);
+  Parser parser(lexer);
+
+  // parse and run the program
+  try {
+    Program ast_root_node;
+    parser.parse(ast_root_node);
+    if (image_out.size()) {
+      Module module;
+      Compiler compiler(module);
+      ast_root_node.accept(compiler);
+      ofstream out(image_out, ios::binary);
+      write_image(module, out);
+      if (not out)
+        throw MyPLException(RUNTIME, "cannot write image '" + image_out + "'", 0, 0);
+    }
+    else if (disassemble_only and engine == "reg") {
+      RegModule module;
+      RegCompiler compiler(module);
+      ast_root_node.accept(compiler);
+      disassemble(module, cout);
+    }
+    else if (disassemble_only) {
+      Module module;
+      Compiler compiler(module, debug);
+      ast_root_node.accept(compiler);
+      disassemble(module, cout);
+    }
+    else if (engine == "vm") {
+      Module module;
+      Compiler compiler(module);
+      ast_root_node.accept(compiler);
+      Runtime runtime(cout);
+      run_vm(runtime, module);
+    }
+    else if (engine == "reg") {
+      RegModule module;
+      RegCompiler compiler(module);
+      ast_root_node.accept(compiler);
+      Runtime runtime(cout);
+      RegVM vm(configure(runtime), module);
+      vm.run();
+      report(runtime);
+    }
+    else if (engine == "closure") {
+      Runtime runtime(cout);
+      ClosureCompiler compiler(configure(runtime));
+      ast_root_node.accept(compiler);
+      compiler.run();
+      report(runtime);
+    }
+    else {
+      Interpreter interpreter(cout);
+      ast_root_node.accept(interpreter);
+    }
+  } catch (MyPLException e) {
+    cout << e.to_string() << endl;
+    exit(1);
+  }
+  // clean up the input stream
+  if (input_stream != &cin)
+    delete input_stream;
+}
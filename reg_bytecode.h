@@ -0,0 +1,154 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: reg_bytecode.h
+// DATE: 10/19/2026
+// DESC: Instruction format for the MyPL register VM. Each instruction
+//       names its destination and source registers directly (three
+//       address code), with the "K" forms taking a constant as the
+//       right operand. Also includes a disassembler.
+//----------------------------------------------------------------------
+
+#ifndef REG_BYTECODE_H
+#define REG_BYTECODE_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "value.h"
+#include "bytecode.h"
+
+
+enum RegOpCode : uint8_t {
+  // R[a] = K[b], nil, bool b, R[b]
+  R_LOADK, R_LOADNIL, R_LOADBOOL, R_MOVE,
+  // R[a] = new type b, R[a] = R[b].name c, R[a].name c = R[b]
+  R_NEW, R_GETFIELD, R_SETFIELD,
+  // R[a] = R[b] op R[c]
+  R_ADD, R_SUB, R_MUL, R_DIV, R_MOD, R_EQ, R_NE, R_LT, R_LE, R_GT, R_GE,
+  // R[a] = R[b] op K[c]
+  R_ADDK, R_SUBK, R_MULK, R_DIVK, R_MODK, R_EQK, R_NEK, R_LTK, R_LEK,
+  R_GTK, R_GEK,
+  // R[a] = op R[b]
+  R_NOT, R_NEG,
+  // goto b; goto b if not R[a]; (and/or) goto b if R[a] is false/true
+  R_JUMP, R_JUMP_IF_FALSE, R_AND, R_OR,
+  // goto c unless R[a] cmp R[b] (R_J*K: unless R[a] cmp K[b])
+  R_JLT, R_JLE, R_JGT, R_JGE, R_JEQ, R_JNE,
+  R_JLTK, R_JLEK, R_JGTK, R_JGEK, R_JEQK, R_JNEK,
+  // counted loops over counter R[a] and limit R[a+1]: check the bounds
+  // are integers and goto c if the loop is empty; step the counter and
+  // goto c unless it was at the limit
+  R_FORPREP, R_FORLOOP,
+  // R[a] = call function b (or built-in b) with the c arguments in R[a]..
+  R_CALL, R_BUILTIN,
+  // return R[a]
+  R_RETURN,
+  // raise the error message K[b]
+  R_ERROR,
+  R_OP_COUNT
+};
+
+
+const char* const reg_op_names[R_OP_COUNT] = {
+  "LOADK", "LOADNIL", "LOADBOOL", "MOVE", "NEW", "GETFIELD", "SETFIELD",
+  "ADD", "SUB", "MUL", "DIV", "MOD", "EQ", "NE", "LT", "LE", "GT", "GE",
+  "ADDK", "SUBK", "MULK", "DIVK", "MODK", "EQK", "NEK", "LTK", "LEK", "GTK", "GEK",
+  "NOT", "NEG", "JUMP", "JUMP_IF_FALSE", "AND", "OR",
+  "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE",
+  "JLTK", "JLEK", "JGTK", "JGEK", "JEQK", "JNEK",
+  "FORPREP", "FORLOOP", "CALL", "BUILTIN", "RETURN", "ERROR"
+};
+
+
+struct RegInstr
+{
+  uint8_t op;
+  uint8_t a;
+  uint16_t b;
+  uint16_t c;
+};
+
+
+struct RegFunction
+{
+  std::string name;
+  int param_count = 0;
+  int register_count = 0;
+  std::vector<RegInstr> code;
+  std::vector<Position> positions;
+};
+
+
+// a compiled program (the types' init functions index functions)
+struct RegModule
+{
+  std::vector<Value> constants;
+  std::vector<std::string> names;
+  std::vector<TypeDef> types;
+  std::vector<RegFunction> functions;
+};
+
+
+// the source location of an instruction (0, 0 if not recorded)
+Position find_position(const RegFunction& fun, int offset)
+{
+  return find_position(fun.positions.data(),
+                       fun.positions.data() + fun.positions.size(), offset);
+}
+
+
+//----------------------------------------------------------------------
+// Disassembler
+//----------------------------------------------------------------------
+
+
+void disassemble(const RegModule& module, const RegFunction& fun, std::ostream& out)
+{
+  out << "function " << fun.name << " (params " << fun.param_count
+      << ", registers " << fun.register_count << ")" << std::endl;
+  for (size_t i = 0; i < fun.code.size(); ++i) {
+    const RegInstr& in = fun.code[i];
+    out << "  " << std::setw(4) << std::setfill('0') << i << std::setfill(' ')
+        << "  " << std::left << std::setw(16) << reg_op_names[in.op] << std::right
+        << (int)in.a << " " << in.b << " " << in.c;
+    std::string comment;
+    if (in.op == R_LOADK or in.op == R_ERROR or (in.op >= R_JLTK and in.op <= R_JNEK))
+      comment = constant_string(module.constants[in.b]);
+    else if (in.op >= R_ADDK and in.op <= R_GEK)
+      comment = constant_string(module.constants[in.c]);
+    else if (in.op == R_GETFIELD or in.op == R_SETFIELD)
+      comment = module.names[in.c];
+    else if (in.op == R_CALL)
+      comment = module.functions[in.b].name;
+    else if (in.op == R_BUILTIN)
+      comment = builtin_names[in.b];
+    else if (in.op == R_NEW)
+      comment = module.types[in.b].name;
+    if (comment.size())
+      out << "\t; " << comment;
+    out << std::endl;
+  }
+}
+
+
+void disassemble(const RegModule& module, std::ostream& out)
+{
+  for (const TypeDef& t : module.types) {
+    out << "type " << t.name << " {";
+    for (size_t i = 0; i < t.fields.size(); ++i)
+      out << (i ? ", " : "") << t.fields[i] << " = " << constant_string(t.defaults[i]);
+    out << "}";
+    if (t.init_function >= 0)
+      out << " init " << module.functions[t.init_function].name;
+    out << std::endl;
+  }
+  for (const RegFunction& fun : module.functions) {
+    out << std::endl;
+    disassemble(module, fun, out);
+  }
+}
+
+
+#endif
@@ -0,0 +1,717 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: reg_compiler.h
+// DATE: 10/19/2026
+// DESC: Compiles the MyPL AST into register VM code (see
+//       reg_bytecode.h). Variables live in fixed registers and
+//       expression temporaries are allocated above them in stack
+//       order, so a function's register file is sized by the most
+//       values live at once. Operands that are already in a variable's
+//       register (or are constants) are used in place.
+//----------------------------------------------------------------------
+
+#ifndef REG_COMPILER_H
+#define REG_COMPILER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ast.h"
+#include "runtime.h"
+#include "reg_bytecode.h"
+
+
+class RegCompiler : public Visitor
+{
+public:
+  // constructor
+  RegCompiler(RegModule& target_module) : module(target_module) {}
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+private:
+  RegModule& module;
+
+  // the function being compiled
+  int curr_fun = -1;
+
+  // type ids, function indexes (the last declaration of a name wins),
+  // and interned constant and name indexes
+  std::unordered_map<std::string,int> type_ids;
+  std::unordered_map<std::string,int> function_ids;
+  int next_fun_decl = 0;
+  std::unordered_map<std::string,int> constant_index;
+  std::unordered_map<std::string,int> name_index;
+
+  // compile-time scopes (variable registers) of the current function
+  std::vector<std::unordered_map<std::string,int>> scopes;
+  int next_slot = 0;
+
+  // registers below local_top hold visible variables, temporaries are
+  // allocated from temp_top
+  int local_top = 0;
+  int temp_top = 0;
+
+  // requested destination register (-1 for any) and the register
+  // holding the last compiled expression's value
+  int dest = -1;
+  int result = -1;
+
+  // helper functions
+  void error(const std::string& msg, const Token& token);
+  RegFunction& fun() {return module.functions[curr_fun];}
+  int offset() {return fun().code.size();}
+  void mark(const Token& token);
+  void emit(uint8_t op, int a, int b, int c);
+  void patch(int at, bool c_operand);
+  void emit_error(const std::string& msg, const Token& token);
+  int add_constant(const Value& val);
+  int add_name(const std::string& name);
+  void begin_function(int index, const std::string& name, int param_count);
+  void end_function();
+  void begin_stmt() {local_top = temp_top = next_slot;}
+  void push_scope() {scopes.emplace_back();}
+  void pop_scope();
+  int lookup(const std::string& name) const;
+  int declare(const std::string& name, const Token& token);
+  int hidden_slot(const Token& token) {return declare("." + std::to_string(next_slot), token);}
+  int alloc_temp(const Token& token);
+  int target(const Token& token) {return dest >= 0 ? dest : alloc_temp(token);}
+  int compile(Expr& expr, int to);
+  void block(std::list<Stmt*>& stmts);
+  void jump_if_false(Expr& expr, std::vector<int>& exits);
+  static bool is_literal(Expr& expr, Token& value);
+  static bool is_comparison(TokenType t);
+};
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+void RegCompiler::error(const std::string& msg, const Token& token)
+{
+  throw MyPLException(SEMANTIC, msg, token.line(), token.column());
+}
+
+
+// record the source location of the next instruction
+void RegCompiler::mark(const Token& token)
+{
+  Position p = {offset(), token.line(), token.column()};
+  fun().positions.push_back(p);
+}
+
+
+// (b and c are registers, or indexes of constants, names, types or
+// functions, or jump targets, none of which may pass 16 bits)
+void RegCompiler::emit(uint8_t op, int a, int b, int c)
+{
+  if (b > 0xFFFF or c > 0xFFFF)
+    throw MyPLException(SEMANTIC, "function '" + fun().name + "' is too large", 0, 0);
+  RegInstr in = {op, (uint8_t)a, (uint16_t)b, (uint16_t)c};
+  fun().code.push_back(in);
+}
+
+
+// set the target of the jump at the given offset to the next instruction
+void RegCompiler::patch(int at, bool c_operand)
+{
+  if (offset() > 0xFFFF)
+    throw MyPLException(SEMANTIC, "function '" + fun().name + "' is too large", 0, 0);
+  if (c_operand)
+    fun().code[at].c = offset();
+  else
+    fun().code[at].b = offset();
+}
+
+
+void RegCompiler::emit_error(const std::string& msg, const Token& token)
+{
+  mark(token);
+  emit(R_ERROR, 0, add_constant(Value::from_string(msg)), 0);
+}
+
+
+int RegCompiler::add_constant(const Value& val)
+{
+  // constants are shared by kind and exact value
+  std::string key = constant_key(val);
+  auto it = constant_index.find(key);
+  if (it != constant_index.end())
+    return it->second;
+  module.constants.push_back(val);
+  int k = module.constants.size() - 1;
+  constant_index[key] = k;
+  return k;
+}
+
+
+int RegCompiler::add_name(const std::string& name)
+{
+  auto it = name_index.find(name);
+  if (it != name_index.end())
+    return it->second;
+  module.names.push_back(name);
+  int k = module.names.size() - 1;
+  name_index[name] = k;
+  return k;
+}
+
+
+void RegCompiler::begin_function(int index, const std::string& name, int param_count)
+{
+  curr_fun = index;
+  fun().name = name;
+  fun().param_count = param_count;
+  next_slot = 0;
+  push_scope();
+}
+
+
+void RegCompiler::end_function()
+{
+  // return nil if the end of the body is reached
+  begin_stmt();
+  int r = alloc_temp(Token());
+  emit(R_LOADNIL, r, 0, 0);
+  emit(R_RETURN, r, 0, 0);
+  pop_scope();
+}
+
+
+void RegCompiler::pop_scope()
+{
+  next_slot -= scopes.back().size();
+  scopes.pop_back();
+}
+
+
+int RegCompiler::lookup(const std::string& name) const
+{
+  for (size_t i = scopes.size(); i > 0; --i) {
+    auto it = scopes[i-1].find(name);
+    if (it != scopes[i-1].end())
+      return it->second;
+  }
+  return -1;
+}
+
+
+// a redeclaration in the same scope reuses the existing register
+int RegCompiler::declare(const std::string& name, const Token& token)
+{
+  auto it = scopes.back().find(name);
+  if (it != scopes.back().end())
+    return it->second;
+  int slot = next_slot++;
+  scopes.back()[name] = slot;
+  if (next_slot > 0xFF)
+    error("too many registers needed in '" + fun().name + "'", token);
+  if (next_slot > fun().register_count)
+    fun().register_count = next_slot;
+  return slot;
+}
+
+
+int RegCompiler::alloc_temp(const Token& token)
+{
+  int r = temp_top++;
+  if (temp_top > 0xFF)
+    error("too many registers needed in '" + fun().name + "'", token);
+  if (temp_top > fun().register_count)
+    fun().register_count = temp_top;
+  return r;
+}
+
+
+// compile the expression into register to (or any register if -1)
+int RegCompiler::compile(Expr& expr, int to)
+{
+  int saved = dest;
+  dest = to;
+  expr.accept(*this);
+  dest = saved;
+  return result;
+}
+
+
+void RegCompiler::block(std::list<Stmt*>& stmts)
+{
+  push_scope();
+  for (Stmt* s : stmts) {
+    begin_stmt();
+    s->accept(*this);
+  }
+  pop_scope();
+}
+
+
+// true if the expression is a lone literal (or nil) value
+bool RegCompiler::is_literal(Expr& expr, Token& value)
+{
+  SimpleTerm* term = dynamic_cast<SimpleTerm*>(expr.first);
+  if (expr.op or expr.negated or not term)
+    return false;
+  SimpleRValue* rval = dynamic_cast<SimpleRValue*>(term->rvalue);
+  if (not rval)
+    return false;
+  value = rval->value;
+  return true;
+}
+
+
+bool RegCompiler::is_comparison(TokenType t)
+{
+  return t == LESS or t == LESS_EQUAL or t == GREATER or t == GREATER_EQUAL or
+    t == EQUAL or t == NOT_EQUAL;
+}
+
+
+// emit a jump taken when the condition is false (comparisons branch
+// directly on their operands), adding the jump offset to exits
+void RegCompiler::jump_if_false(Expr& expr, std::vector<int>& exits)
+{
+  int saved_top = temp_top;
+  if (expr.op and not expr.negated and is_comparison(expr.op->type())) {
+    static const TokenType ops[] = {LESS, LESS_EQUAL, GREATER, GREATER_EQUAL,
+                                    EQUAL, NOT_EQUAL};
+    int op = 0;
+    while (ops[op] != expr.op->type())
+      ++op;
+    dest = -1;
+    expr.first->accept(*this);
+    int lhs = result;
+    Token value;
+    if (is_literal(*expr.rest, value) and value.type() != NIL and
+        value.type() != BOOL_VAL) {
+      mark(*expr.op);
+      exits.push_back(offset());
+      emit(R_JLTK + op, lhs, add_constant(Runtime::literal(value)), 0);
+    }
+    else {
+      int rhs = compile(*expr.rest, -1);
+      mark(*expr.op);
+      exits.push_back(offset());
+      emit(R_JLT + op, lhs, rhs, 0);
+    }
+  }
+  else {
+    int r = compile(expr, -1);
+    mark(Token());
+    exits.push_back(offset());
+    emit(R_JUMP_IF_FALSE, r, 0, 0);
+  }
+  temp_top = saved_top;
+}
+
+
+//----------------------------------------------------------------------
+// Top-Level Visitor Functions
+//----------------------------------------------------------------------
+
+
+void RegCompiler::visit(Program& node)
+{
+  // types are numbered up front (new needs the type id)
+  for (Decl* d : node.decls) {
+    TypeDecl* t = dynamic_cast<TypeDecl*>(d);
+    if (t and not type_ids.count(t->id.lexeme())) {
+      type_ids[t->id.lexeme()] = module.types.size();
+      module.types.emplace_back();
+    }
+  }
+  // as are functions, so calls are linked directly (the init functions
+  // of types come after them)
+  for (Decl* d : node.decls) {
+    FunDecl* f = dynamic_cast<FunDecl*>(d);
+    if (f) {
+      function_ids[f->id.lexeme()] = module.functions.size();
+      module.functions.emplace_back();
+      module.functions.back().param_count = f->params.size();
+    }
+  }
+  for (Decl* d : node.decls)
+    d->accept(*this);
+}
+
+
+void RegCompiler::visit(FunDecl& node)
+{
+  begin_function(next_fun_decl++, node.id.lexeme(), node.params.size());
+  for (FunDecl::FunParam& p : node.params)
+    declare(p.id.lexeme(), p.id);
+  // parameters always occupy the first registers (even if repeated)
+  while (next_slot < fun().param_count)
+    hidden_slot(node.id);
+  block(node.stmts);
+  end_function();
+}
+
+
+void RegCompiler::visit(TypeDecl& node)
+{
+  TypeDef& t = module.types[type_ids[node.id.lexeme()]];
+  t = TypeDef();
+  t.name = node.id.lexeme();
+  std::unordered_map<std::string,int> index;
+  std::vector<VarDeclStmt*> computed;
+  for (VarDeclStmt* v : node.vdecls) {
+    const std::string& name = v->id.lexeme();
+    if (not index.count(name)) {
+      index[name] = t.fields.size();
+      t.fields.push_back(name);
+      t.defaults.push_back(Value());
+    }
+    Token value;
+    if (is_literal(*v->expr, value))
+      t.defaults[index[name]] = Runtime::literal(value);
+    else
+      computed.push_back(v);
+  }
+  if (computed.empty())
+    return;
+  // the remaining fields are set by an init function that takes and
+  // returns the new object (its name cannot clash with a MyPL function)
+  std::vector<std::unordered_map<std::string,int>> saved;
+  saved.swap(scopes);
+  module.functions.emplace_back();
+  begin_function(module.functions.size() - 1, t.name + ".init", 1);
+  t.init_function = curr_fun;
+  hidden_slot(node.id);
+  for (VarDeclStmt* v : computed) {
+    begin_stmt();
+    int r = compile(*v->expr, -1);
+    mark(v->id);
+    emit(R_SETFIELD, 0, r, add_name(v->id.lexeme()));
+  }
+  emit(R_RETURN, 0, 0, 0);
+  pop_scope();
+  scopes.swap(saved);
+}
+
+
+//----------------------------------------------------------------------
+// Statement Visitor Functions
+//----------------------------------------------------------------------
+
+
+void RegCompiler::visit(VarDeclStmt& node)
+{
+  // a new variable's register is not visible to its initializer, so it
+  // doubles as the first temporary and the value is computed in place
+  int slot = scopes.back().count(node.id.lexeme()) ?
+    scopes.back()[node.id.lexeme()] : next_slot;
+  compile(*node.expr, slot);
+  declare(node.id.lexeme(), node.id);
+}
+
+
+void RegCompiler::visit(AssignStmt& node)
+{
+  const Token& root = node.lvalue_list.front();
+  int slot = lookup(root.lexeme());
+  if (slot >= 0 and node.lvalue_list.size() == 1) {
+    compile(*node.expr, slot);
+    return;
+  }
+  int val = compile(*node.expr, -1);
+  if (slot < 0) {
+    emit_error("undefined variable '" + root.lexeme() + "'", root);
+    return;
+  }
+  int obj = slot;
+  auto it = ++node.lvalue_list.begin();
+  for (; it != --node.lvalue_list.end(); ++it) {
+    int r = obj == slot ? alloc_temp(*it) : obj;
+    mark(*it);
+    emit(R_GETFIELD, r, obj, add_name(it->lexeme()));
+    obj = r;
+  }
+  mark(*it);
+  emit(R_SETFIELD, obj, val, add_name(it->lexeme()));
+}
+
+
+void RegCompiler::visit(ReturnStmt& node)
+{
+  emit(R_RETURN, compile(*node.expr, -1), 0, 0);
+}
+
+
+void RegCompiler::visit(IfStmt& node)
+{
+  std::vector<int> exits;
+  std::vector<BasicIf*> parts(1, node.if_part);
+  parts.insert(parts.end(), node.else_ifs.begin(), node.else_ifs.end());
+  for (BasicIf* part : parts) {
+    std::vector<int> next;
+    begin_stmt();
+    jump_if_false(*part->expr, next);
+    block(part->stmts);
+    if (part != parts.back() or node.body_stmts.size()) {
+      exits.push_back(offset());
+      emit(R_JUMP, 0, 0, 0);
+    }
+    for (int at : next)
+      patch(at, fun().code[at].op != R_JUMP_IF_FALSE);
+  }
+  block(node.body_stmts);
+  for (int at : exits)
+    patch(at, false);
+}
+
+
+void RegCompiler::visit(WhileStmt& node)
+{
+  int start = offset();
+  std::vector<int> exits;
+  jump_if_false(*node.expr, exits);
+  block(node.stmts);
+  emit(R_JUMP, 0, start, 0);
+  for (int at : exits)
+    patch(at, fun().code[at].op != R_JUMP_IF_FALSE);
+}
+
+
+void RegCompiler::visit(ForStmt& node)
+{
+  // the bounds are kept in adjacent hidden registers (FORPREP skips the
+  // loop if it is empty) and the loop variable is a copy of the
+  // counter; FORLOOP steps the counter and jumps back to the body
+  push_scope();
+  int counter = hidden_slot(node.var_id);
+  int limit = hidden_slot(node.var_id);
+  begin_stmt();
+  compile(*node.start, counter);
+  compile(*node.end, limit);
+  mark(node.var_id);
+  int prep = offset();
+  emit(R_FORPREP, counter, 0, 0);
+  int body = offset();
+  push_scope();
+  emit(R_MOVE, declare(node.var_id.lexeme(), node.var_id), counter, 0);
+  block(node.stmts);
+  pop_scope();
+  emit(R_FORLOOP, counter, 0, body);
+  patch(prep, true);
+  pop_scope();
+}
+
+
+//----------------------------------------------------------------------
+// Expression Visitor Functions
+//----------------------------------------------------------------------
+
+
+void RegCompiler::visit(Expr& node)
+{
+  int to = dest;
+  if (node.op and (node.op->type() == AND or node.op->type() == OR)) {
+    // and/or short circuit on the (boolean) left operand; the result
+    // register is written before the right operand is read, so it
+    // cannot be a visible variable's register
+    int r = to >= 0 and to >= local_top ? to : alloc_temp(*node.op);
+    dest = r;
+    node.first->accept(*this);
+    if (result != r)
+      emit(R_MOVE, r, result, 0);
+    mark(*node.op);
+    int at = offset();
+    emit(node.op->type() == AND ? R_AND : R_OR, r, 0, 0);
+    compile(*node.rest, r);
+    patch(at, false);
+    if (to >= 0 and to != r)
+      emit(R_MOVE, to, r, 0);
+    result = to >= 0 ? to : r;
+  }
+  else if (node.op) {
+    int saved_top = temp_top;
+    dest = -1;
+    node.first->accept(*this);
+    int lhs = result;
+    Token value;
+    int rhs = -1;
+    bool is_const = is_literal(*node.rest, value) and value.type() != NIL and
+      value.type() != BOOL_VAL;
+    if (is_const)
+      rhs = add_constant(Runtime::literal(value));
+    else
+      rhs = compile(*node.rest, -1);
+    temp_top = saved_top;
+    dest = to;
+    int r = target(*node.op);
+    static const TokenType ops[] = {PLUS, MINUS, MULTIPLY, DIVIDE, MODULO, EQUAL,
+                                    NOT_EQUAL, LESS, LESS_EQUAL, GREATER,
+                                    GREATER_EQUAL};
+    int op = 0;
+    while (ops[op] != node.op->type())
+      ++op;
+    mark(*node.op);
+    emit((is_const ? R_ADDK : R_ADD) + op, r, lhs, rhs);
+    result = r;
+  }
+  else {
+    dest = to;
+    node.first->accept(*this);
+  }
+  if (node.negated) {
+    dest = to;
+    int r = to >= 0 ? to : (result >= local_top ? result : alloc_temp(Token()));
+    emit(R_NOT, r, result, 0);
+    result = r;
+  }
+  dest = to;
+}
+
+
+void RegCompiler::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+
+void RegCompiler::visit(ComplexTerm& node)
+{
+  result = compile(*node.expr, dest);
+}
+
+
+//----------------------------------------------------------------------
+// RValue Visitor Functions
+//----------------------------------------------------------------------
+
+
+void RegCompiler::visit(SimpleRValue& node)
+{
+  Value val = Runtime::literal(node.value);
+  int r = target(node.value);
+  if (val.is_nil())
+    emit(R_LOADNIL, r, 0, 0);
+  else if (val.is_bool())
+    emit(R_LOADBOOL, r, val.as_bool(), 0);
+  else
+    emit(R_LOADK, r, add_constant(val), 0);
+  result = r;
+}
+
+
+void RegCompiler::visit(NewRValue& node)
+{
+  auto t = type_ids.find(node.type_id.lexeme());
+  if (t == type_ids.end()) {
+    emit_error("undefined type '" + node.type_id.lexeme() + "'", node.type_id);
+    result = target(node.type_id);
+    return;
+  }
+  int r = target(node.type_id);
+  emit(R_NEW, r, t->second, 0);
+  result = r;
+}
+
+
+void RegCompiler::visit(CallExpr& node)
+{
+  // the arguments are placed in consecutive registers starting at base
+  // (the destination if no live temporaries are above it)
+  int to = dest;
+  if (to >= local_top and to + 1 >= temp_top)
+    temp_top = to;
+  int base = temp_top;
+  for (Expr* e : node.arg_list) {
+    int r = alloc_temp(node.function_id);
+    compile(*e, r);
+    temp_top = r + 1;
+  }
+  if (node.arg_list.empty())
+    alloc_temp(node.function_id);
+  // user functions take precedence over built-ins, and the arguments
+  // are evaluated before a call error is raised
+  const std::string& name = node.function_id.lexeme();
+  int argc = node.arg_list.size();
+  auto f = function_ids.find(name);
+  int builtin = Runtime::builtin_id(name);
+  if (f != function_ids.end() and module.functions[f->second].param_count != argc)
+    emit_error("wrong number of arguments to '" + name + "'", node.function_id);
+  else if (f != function_ids.end()) {
+    mark(node.function_id);
+    emit(R_CALL, base, f->second, argc);
+  }
+  else if (builtin >= 0) {
+    mark(node.function_id);
+    emit(R_BUILTIN, base, builtin, argc);
+  }
+  else
+    emit_error("undefined function '" + name + "'", node.function_id);
+  temp_top = base + 1;
+  result = base;
+  if (to >= 0 and to != base) {
+    emit(R_MOVE, to, base, 0);
+    temp_top = base;
+    result = to;
+  }
+}
+
+
+void RegCompiler::visit(IDRValue& node)
+{
+  const Token& root = node.path.front();
+  int slot = lookup(root.lexeme());
+  if (slot < 0) {
+    emit_error("undefined variable '" + root.lexeme() + "'", root);
+    result = target(root);
+    return;
+  }
+  if (node.path.size() == 1) {
+    // a variable is used in place unless a register was requested
+    if (dest >= 0 and dest != slot)
+      emit(R_MOVE, dest, slot, 0);
+    result = dest >= 0 ? dest : slot;
+    return;
+  }
+  int r = target(root);
+  int obj = slot;
+  for (auto it = ++node.path.begin(); it != node.path.end(); ++it) {
+    mark(*it);
+    emit(R_GETFIELD, r, obj, add_name(it->lexeme()));
+    obj = r;
+  }
+  result = r;
+}
+
+
+void RegCompiler::visit(NegatedRValue& node)
+{
+  int to = dest;
+  int saved_top = temp_top;
+  int val = compile(*node.expr, -1);
+  temp_top = saved_top;
+  dest = to;
+  int r = target(Token());
+  emit(R_NEG, r, val, 0);
+  result = r;
+}
+
+
+#endif
@@ -0,0 +1,421 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: reg_vm.h
+// DATE: 10/19/2026
+// DESC: Register-based virtual machine for MyPL (see reg_bytecode.h).
+//       Register files live on one contiguous value stack. A call's
+//       register window starts at the caller's call register, so the
+//       arguments are already in the callee's first registers, and the
+//       result is written back to the caller's call register. The
+//       register files up to the top frame's are the object heap's
+//       root set (heap.h).
+//----------------------------------------------------------------------
+
+#ifndef REG_VM_H
+#define REG_VM_H
+
+#include <string>
+#include <vector>
+#include "runtime.h"
+#include "reg_bytecode.h"
+
+
+class RegVM : public RootSource
+{
+public:
+  // load the module's types and functions into the runtime
+  RegVM(Runtime& runtime, const RegModule& program_module);
+  ~RegVM();
+  RegVM(const RegVM&) = delete;
+  RegVM& operator=(const RegVM&) = delete;
+
+  // run the program's main function
+  void run();
+
+  // count the instructions executed by run (off by default)
+  void count_instructions(bool on) {counting = on;}
+  long instructions() const {return instruction_count;}
+
+  // mark the objects referenced from the frames' registers
+  void mark_roots(Heap& heap);
+
+private:
+  // the slot of a field instruction's field in the last type it
+  // accessed (type_id is -1 until then)
+  struct FieldCache
+  {
+    int type_id;
+    int slot;
+  };
+
+  // a function activation (regs points into the value stack, caches
+  // are the function's field caches by instruction, and result is the
+  // caller's register for the return value)
+  struct Frame
+  {
+    const RegFunction* fun;
+    const RegInstr* ip;
+    Value* regs;
+    FieldCache* caches;
+    int result;
+  };
+
+  Runtime& rt;
+  const RegModule& module;
+
+  // the value stack (registers above the top frame's are dead),
+  // extended by STACK_CHUNK values at a time when a call would pass
+  // its end
+  static const size_t STACK_CHUNK = 16384;
+  Value* stack = nullptr;
+  Value* stack_end = nullptr;
+  std::vector<Frame> frames;
+
+  // each function's field caches
+  std::vector<std::vector<FieldCache>> field_caches;
+
+  bool counting = false;
+  long instruction_count = 0;
+
+  // helper functions
+  template<bool Count> void execute();
+  void error(const std::string& msg, const Frame& frame, const RegInstr* ip);
+  Position position(const Frame& frame, const RegInstr* ip);
+  void grow(Value*& regs, size_t needed);
+  void call(const RegFunction& fun, Value* regs, int argc, int result);
+  int field(Object* obj, const Frame& frame, const RegInstr* ip);
+  static bool int_binary(int op, int x, int y, Value& result);
+};
+
+
+RegVM::RegVM(Runtime& runtime, const RegModule& program_module)
+  : rt(runtime), module(program_module)
+{
+  for (const TypeDef& t : module.types)
+    rt.add_type(t.name, t.fields);
+  FieldCache empty = {-1, 0};
+  for (const RegFunction& fun : module.functions)
+    field_caches.emplace_back(fun.code.size(), empty);
+  stack = new Value[STACK_CHUNK];
+  stack_end = stack + STACK_CHUNK;
+  frames.reserve(256);
+  rt.heap().set_roots(this);
+}
+
+
+RegVM::~RegVM()
+{
+  rt.heap().set_roots(nullptr);
+  delete[] stack;
+}
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+Position RegVM::position(const Frame& frame, const RegInstr* ip)
+{
+  return find_position(*frame.fun, ip - frame.fun->code.data());
+}
+
+
+void RegVM::error(const std::string& msg, const Frame& frame, const RegInstr* ip)
+{
+  Position p = position(frame, ip);
+  Runtime::error(msg, p.line, p.column);
+}
+
+
+// (each frame's registers are set when it is called, and the frames'
+// register files are contiguous)
+void RegVM::mark_roots(Heap& heap)
+{
+  if (frames.empty())
+    return;
+  const Frame& top = frames.back();
+  for (Value* v = stack; v != top.regs + top.fun->register_count; ++v)
+    heap.visit(*v);
+}
+
+
+// move the value stack to one with room for needed values from regs
+// (rarely needed, so the frames' pointers are just rebased)
+void RegVM::grow(Value*& regs, size_t needed)
+{
+  size_t size = stack_end - stack;
+  size_t used = regs - stack;
+  size_t new_size = size + STACK_CHUNK * ((used + needed - size) / STACK_CHUNK + 1);
+  Value* new_stack = new Value[new_size];
+  for (size_t i = 0; i < size; ++i)
+    new_stack[i] = std::move(stack[i]);
+  for (Frame& frame : frames)
+    frame.regs = new_stack + (frame.regs - stack);
+  delete[] stack;
+  stack = new_stack;
+  stack_end = new_stack + new_size;
+  regs = new_stack + used;
+}
+
+
+// push a new frame whose register window starts at regs (holding the
+// arguments), clearing the rest of the window
+void RegVM::call(const RegFunction& fun, Value* regs, int argc, int result)
+{
+  if (stack_end - regs < fun.register_count)
+    grow(regs, fun.register_count);
+  for (int i = argc; i < fun.register_count; ++i)
+    regs[i] = Value();
+  Frame frame = {&fun, fun.code.data(), regs,
+                 field_caches[&fun - module.functions.data()].data(), result};
+  frames.push_back(frame);
+}
+
+
+// index in an object of the field a GETFIELD or SETFIELD names, from
+// the instruction's cache if it has the object's type (otherwise looked
+// up and cached); an error if not a field
+inline int RegVM::field(Object* obj, const Frame& frame, const RegInstr* ip)
+{
+  FieldCache& cache = frame.caches[ip - frame.fun->code.data()];
+  if (obj->type_id == cache.type_id)
+    return cache.slot;
+  int i = rt.field_index(obj->type_id, module.names[ip->c]);
+  if (i < 0)
+    error("undefined field '" + module.names[ip->c] + "'", frame, ip);
+  cache.type_id = obj->type_id;
+  cache.slot = i;
+  return i;
+}
+
+
+// integer arithmetic and comparison (op is relative to R_ADD), false
+// if the operation needs the runtime (division by 0 or -1)
+inline bool RegVM::int_binary(int op, int i, int j, Value& result)
+{
+  unsigned x = i, y = j;
+  switch(op) {
+    case R_ADD - R_ADD: result = Value::from_int(x + y); return true;
+    case R_SUB - R_ADD: result = Value::from_int(x - y); return true;
+    case R_MUL - R_ADD: result = Value::from_int(x * y); return true;
+    case R_DIV - R_ADD:
+      if (j == 0 or j == -1)
+        return false;
+      result = Value::from_int(i / j);
+      return true;
+    case R_MOD - R_ADD:
+      if (j == 0 or j == -1)
+        return false;
+      result = Value::from_int(i % j);
+      return true;
+    case R_EQ - R_ADD: result = Value::from_bool(i == j); return true;
+    case R_NE - R_ADD: result = Value::from_bool(i != j); return true;
+    case R_LT - R_ADD: result = Value::from_bool(i < j); return true;
+    case R_LE - R_ADD: result = Value::from_bool(i <= j); return true;
+    case R_GT - R_ADD: result = Value::from_bool(i > j); return true;
+    default: result = Value::from_bool(i >= j); return true;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Interpreter Loop
+//----------------------------------------------------------------------
+
+
+void RegVM::run()
+{
+  // (a run ended by an error leaves its frames' values on the stack)
+  if (not frames.empty())
+    for (Value* v = stack; v != stack_end; ++v)
+      *v = Value();
+  instruction_count = 0;
+  if (counting)
+    execute<true>();
+  else
+    execute<false>();
+}
+
+
+template<bool Count>
+void RegVM::execute()
+{
+  static const TokenType ops[] = {PLUS, MINUS, MULTIPLY, DIVIDE, MODULO, EQUAL,
+                                  NOT_EQUAL, LESS, LESS_EQUAL, GREATER,
+                                  GREATER_EQUAL};
+  // the fused jumps' comparisons, in R_JLT order (as R_ADD offsets)
+  static const int jump_ops[] = {R_LT - R_ADD, R_LE - R_ADD, R_GT - R_ADD,
+                                 R_GE - R_ADD, R_EQ - R_ADD, R_NE - R_ADD};
+
+  // (the last main declared, as for calls)
+  size_t main = module.functions.size();
+  while (main > 0 and module.functions[main - 1].name != "main")
+    --main;
+  if (main == 0)
+    throw MyPLException(RUNTIME, "undefined 'main' function", 0, 0);
+  frames.clear();
+  call(module.functions[main - 1], stack, 0, 0);
+
+  Frame* frame = &frames.back();
+  const RegInstr* ip = frame->ip;
+  Value* R = frame->regs;
+  const Value* K = module.constants.data();
+  while (true) {
+    const RegInstr* in = ip++;
+    if (Count)
+      ++instruction_count;
+    switch(in->op) {
+      case R_LOADK:
+        R[in->a] = K[in->b];
+        break;
+      case R_LOADNIL:
+        R[in->a] = Value();
+        break;
+      case R_LOADBOOL:
+        R[in->a] = Value::from_bool(in->b);
+        break;
+      case R_MOVE:
+        R[in->a] = R[in->b];
+        break;
+      case R_NEW: {
+        const TypeDef& t = module.types[in->b];
+        R[in->a] = rt.new_object(in->b);
+        rt.heap().copy_fields(R[in->a].as_object(), t.defaults);
+        if (t.init_function >= 0) {
+          // (a's register may be a variable's, so the init function's
+          // window goes above the whole register file)
+          Value* window = R + frame->fun->register_count;
+          if (window == stack_end)
+            grow(window, 1);
+          *window = frame->regs[in->a];
+          frame->ip = ip;
+          call(module.functions[t.init_function], window, 1, in->a);
+          frame = &frames.back();
+          ip = frame->ip;
+          R = frame->regs;
+        }
+        break;
+      }
+      case R_GETFIELD: {
+        Position p = {0, 0, 0};
+        if (not R[in->b].is_object())
+          p = position(*frame, in);
+        Object* obj = rt.deref(R[in->b], module.names[in->c], p.line, p.column);
+        R[in->a] = obj->fields()[field(obj, *frame, in)];
+        break;
+      }
+      case R_SETFIELD: {
+        Position p = {0, 0, 0};
+        if (not R[in->a].is_object())
+          p = position(*frame, in);
+        Object* obj = rt.deref(R[in->a], module.names[in->c], p.line, p.column);
+        rt.heap().store(obj, field(obj, *frame, in), R[in->b]);
+        break;
+      }
+      case R_ADD: case R_SUB: case R_MUL: case R_DIV: case R_MOD:
+      case R_EQ: case R_NE: case R_LT: case R_LE: case R_GT: case R_GE:
+      case R_ADDK: case R_SUBK: case R_MULK: case R_DIVK: case R_MODK:
+      case R_EQK: case R_NEK: case R_LTK: case R_LEK: case R_GTK: case R_GEK: {
+        bool is_const = in->op >= R_ADDK;
+        int op = in->op - (is_const ? R_ADDK : R_ADD);
+        const Value& a = R[in->b];
+        const Value& b = is_const ? K[in->c] : R[in->c];
+        if (a.is_int() and b.is_int() and int_binary(op, a.as_int(), b.as_int(), R[in->a]))
+          break;
+        Position p = position(*frame, in);
+        R[in->a] = rt.binary(ops[op], a, b, p.line, p.column);
+        break;
+      }
+      case R_NOT:
+        if (not R[in->b].is_bool())
+          Runtime::error("expecting boolean operand for 'not'", 0, 0);
+        R[in->a] = Value::from_bool(not R[in->b].as_bool());
+        break;
+      case R_NEG:
+        R[in->a] = rt.negate(R[in->b], 0, 0);
+        break;
+      case R_JUMP:
+        ip = frame->fun->code.data() + in->b;
+        break;
+      case R_JUMP_IF_FALSE:
+        if (not R[in->a].is_bool())
+          error("expecting boolean condition", *frame, in);
+        if (not R[in->a].as_bool())
+          ip = frame->fun->code.data() + in->b;
+        break;
+      case R_AND:
+      case R_OR:
+        if (not R[in->a].is_bool()) {
+          std::string name = in->op == R_AND ? "and" : "or";
+          error("expecting boolean operand for '" + name + "'", *frame, in);
+        }
+        if (R[in->a].as_bool() == (in->op == R_OR))
+          ip = frame->fun->code.data() + in->b;
+        break;
+      case R_JLT: case R_JLE: case R_JGT: case R_JGE: case R_JEQ: case R_JNE:
+      case R_JLTK: case R_JLEK: case R_JGTK: case R_JGEK: case R_JEQK: case R_JNEK: {
+        bool is_const = in->op >= R_JLTK;
+        int op = jump_ops[in->op - (is_const ? R_JLTK : R_JLT)];
+        const Value& a = R[in->a];
+        const Value& b = is_const ? K[in->b] : R[in->b];
+        Value cmp;
+        if (not a.is_int() or not b.is_int()) {
+          Position p = position(*frame, in);
+          cmp = rt.binary(ops[op], a, b, p.line, p.column);
+        }
+        else
+          int_binary(op, a.as_int(), b.as_int(), cmp);
+        if (not cmp.as_bool())
+          ip = frame->fun->code.data() + in->c;
+        break;
+      }
+      case R_FORPREP:
+        if (not R[in->a].is_int() or not R[in->a + 1].is_int())
+          error("expecting integer for loop bounds", *frame, in);
+        if (R[in->a].as_int() > R[in->a + 1].as_int())
+          ip = frame->fun->code.data() + in->c;
+        break;
+      case R_FORLOOP: {
+        // (stopping at the limit, so the counter cannot overflow)
+        int i = R[in->a].as_int();
+        if (i < R[in->a + 1].as_int()) {
+          R[in->a] = Value::from_int(i + 1);
+          ip = frame->fun->code.data() + in->c;
+        }
+        break;
+      }
+      case R_CALL:
+        frame->ip = ip;
+        call(module.functions[in->b], R + in->a, in->c, in->a);
+        frame = &frames.back();
+        ip = frame->ip;
+        R = frame->regs;
+        break;
+      case R_BUILTIN: {
+        Position p = position(*frame, in);
+        R[in->a] = rt.call_builtin(in->b, R + in->a, in->c, p.line, p.column);
+        break;
+      }
+      case R_RETURN: {
+        const Value& result = R[in->a];
+        int to = frame->result;
+        frames.pop_back();
+        if (frames.empty())
+          return;
+        frame = &frames.back();
+        ip = frame->ip;
+        R = frame->regs;
+        if (&R[to] != &result)
+          R[to] = result;
+        break;
+      }
+      case R_ERROR:
+        error(K[in->b].as_string(), *frame, in);
+        break;
+    }
+  }
+}
+
+
+#endif
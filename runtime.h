@@ -0,0 +1,432 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: runtime.h
+// DATE: 10/19/2026
+// DESC: Runtime support shared by the compiled MyPL execution engines:
+//       type layouts, the garbage-collected object heap (heap.h), the
+//       generic (slow path)
+//       operators, and the built-in functions. The semantics match
+//       the AST interpreter (interpreter.h). Printed output is
+//       collected in a buffer and written out in large blocks.
+//----------------------------------------------------------------------
+
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "value.h"
+#include "heap.h"
+
+
+// the built-in functions (ids are fixed)
+enum Builtin {B_PRINT, B_READ, B_LENGTH, B_GET, B_CONCAT, B_ITOS, B_DTOS,
+              B_STOI, B_STOD, BUILTIN_COUNT};
+
+const char* const builtin_names[BUILTIN_COUNT] = {
+  "print", "read", "length", "get", "concat", "itos", "dtos", "stoi", "stod"
+};
+
+
+// field layout of a user-defined type
+struct TypeInfo
+{
+  std::string name;
+  std::vector<std::string> fields;
+  std::unordered_map<std::string,int> field_index;
+};
+
+
+class Runtime
+{
+public:
+  Runtime(std::ostream& output_stream) : out(output_stream) {}
+  ~Runtime();
+
+  // throw a runtime error at the given location
+  static void error(const std::string& msg, int line, int column);
+
+  // register a type, returning its id
+  int add_type(const std::string& name, const std::vector<std::string>& fields);
+  const TypeInfo& type(int type_id) const {return types[type_id];}
+  int type_count() const {return types.size();}
+
+  // index of a field in a type's layout (-1 if not a field)
+  int field_index(int type_id, const std::string& field) const;
+
+  // allocate a new object with nil fields
+  Value new_object(int type_id);
+
+  // the object heap (engines that can find all their references to
+  // objects set themselves as its roots, enabling collection)
+  Heap& heap() {return object_heap;}
+
+  // bytes used by the allocated objects (headers and fields)
+  size_t heap_bytes() const {return object_heap.bytes_in_use();}
+
+  // the object referenced by a field access base value
+  Object* deref(const Value& val, const std::string& field, int line, int column);
+
+  // generic operators (on any operand kinds)
+  Value binary(TokenType op, const Value& lhs, const Value& rhs, int line, int column);
+  Value negate(const Value& val, int line, int column);
+  static bool equal(const Value& lhs, const Value& rhs);
+  static void operand_error(TokenType op, int line, int column);
+
+  // the string printed for a value
+  std::string to_string(const Value& val) const;
+
+  // write a number's digits to buf (room for at least 32 characters),
+  // returning their length (doubles as ostreams print them by default)
+  static int format_int(int val, char* buf);
+  static int format_double(double val, char* buf);
+
+  // write out the buffered output (done when the buffer fills, before
+  // reading input, and when the runtime is destroyed)
+  void flush();
+
+  // the value of a literal token (nil for anything else)
+  static Value literal(const Token& token);
+
+  // built-in function support
+  static int builtin_id(const std::string& name);
+  Value call_builtin(int id, const Value* args, int argc, int line, int column);
+
+private:
+  static const size_t OUTPUT_BUFFER_SIZE = 1 << 16;
+
+  std::ostream& out;
+  std::string output;
+  std::vector<TypeInfo> types;
+  Heap object_heap;
+
+  void write(const char* s, size_t n);
+  void print(const Value& val);
+};
+
+
+Runtime::~Runtime()
+{
+  flush();
+}
+
+
+void Runtime::error(const std::string& msg, int line, int column)
+{
+  throw MyPLException(RUNTIME, msg, line, column);
+}
+
+
+int Runtime::add_type(const std::string& name, const std::vector<std::string>& fields)
+{
+  TypeInfo t;
+  t.name = name;
+  for (const std::string& f : fields) {
+    if (not t.field_index.count(f)) {
+      t.field_index[f] = t.fields.size();
+      t.fields.push_back(f);
+    }
+  }
+  types.push_back(t);
+  object_heap.add_type(t.fields.size());
+  return types.size() - 1;
+}
+
+
+int Runtime::field_index(int type_id, const std::string& field) const
+{
+  auto it = types[type_id].field_index.find(field);
+  return it == types[type_id].field_index.end() ? -1 : it->second;
+}
+
+
+Value Runtime::new_object(int type_id)
+{
+  return Value::from_object(object_heap.allocate(type_id));
+}
+
+
+Object* Runtime::deref(const Value& val, const std::string& field, int line, int column)
+{
+  if (val.is_nil())
+    error("nil reference accessing '" + field + "'", line, column);
+  if (not val.is_object())
+    error("'" + field + "' is not a field of a struct", line, column);
+  return val.as_object();
+}
+
+
+bool Runtime::equal(const Value& lhs, const Value& rhs)
+{
+  if (lhs.kind() != rhs.kind())
+    return false;
+  switch(lhs.kind()) {
+    case V_INT: return lhs.as_int() == rhs.as_int();
+    case V_DOUBLE: return lhs.as_double() == rhs.as_double();
+    case V_BOOL: return lhs.as_bool() == rhs.as_bool();
+    case V_CHAR: return lhs.as_char() == rhs.as_char();
+    case V_STRING: return Value::string_equal(lhs, rhs);
+    case V_OBJECT: return lhs.as_object() == rhs.as_object();
+    default: return true;
+  }
+}
+
+
+void Runtime::operand_error(TokenType op, int line, int column)
+{
+  std::string s = op == PLUS ? "+" : op == MINUS ? "-" : op == MULTIPLY ? "*" :
+    op == DIVIDE ? "/" : op == MODULO ? "%" : op == LESS ? "<" : op == LESS_EQUAL ?
+    "<=" : op == GREATER ? ">" : ">=";
+  error("invalid operand types for '" + s + "'", line, column);
+}
+
+
+Value Runtime::binary(TokenType op, const Value& lhs, const Value& rhs,
+                      int line, int column)
+{
+  if (op == EQUAL)
+    return Value::from_bool(equal(lhs, rhs));
+  if (op == NOT_EQUAL)
+    return Value::from_bool(not equal(lhs, rhs));
+  if (op == LESS or op == LESS_EQUAL or op == GREATER or op == GREATER_EQUAL) {
+    int c = 0;
+    if (lhs.is_int() and rhs.is_int())
+      c = (lhs.as_int() > rhs.as_int()) - (lhs.as_int() < rhs.as_int());
+    else if (lhs.is_double() and rhs.is_double())
+      c = (lhs.as_double() > rhs.as_double()) - (lhs.as_double() < rhs.as_double());
+    else if (lhs.is_char() and rhs.is_char())
+      c = (lhs.as_char() > rhs.as_char()) - (lhs.as_char() < rhs.as_char());
+    else if (lhs.is_string() and rhs.is_string())
+      c = lhs.as_string().compare(rhs.as_string());
+    else
+      operand_error(op, line, column);
+    if (op == LESS) return Value::from_bool(c < 0);
+    if (op == LESS_EQUAL) return Value::from_bool(c <= 0);
+    if (op == GREATER) return Value::from_bool(c > 0);
+    return Value::from_bool(c >= 0);
+  }
+  // string concatenation
+  if (op == PLUS and (lhs.is_string() or lhs.is_char()) and
+      (rhs.is_string() or rhs.is_char())) {
+    if (lhs.is_char() or rhs.is_char())
+      return Value::make_string(to_string(lhs) + to_string(rhs));
+    return Value::concat(lhs, rhs);
+  }
+  if (lhs.is_int() and rhs.is_int()) {
+    // wrap on overflow (computed unsigned to stay well defined)
+    unsigned x = lhs.as_int(), y = rhs.as_int();
+    if ((op == DIVIDE or op == MODULO) and y == 0)
+      error("division by zero", line, column);
+    switch(op) {
+      case PLUS: return Value::from_int(x + y);
+      case MINUS: return Value::from_int(x - y);
+      case MULTIPLY: return Value::from_int(x * y);
+      case DIVIDE: return Value::from_int(y == -1u ? 0u - x : lhs.as_int() / rhs.as_int());
+      default: return Value::from_int(y == -1u ? 0 : lhs.as_int() % rhs.as_int());
+    }
+  }
+  if (lhs.is_double() and rhs.is_double() and op != MODULO) {
+    double x = lhs.as_double(), y = rhs.as_double();
+    switch(op) {
+      case PLUS: return Value::from_double(x + y);
+      case MINUS: return Value::from_double(x - y);
+      case MULTIPLY: return Value::from_double(x * y);
+      default: return Value::from_double(x / y);
+    }
+  }
+  operand_error(op, line, column);
+  return Value();
+}
+
+
+Value Runtime::negate(const Value& val, int line, int column)
+{
+  if (val.is_int())
+    return Value::from_int(0u - (unsigned)val.as_int());
+  if (val.is_double())
+    return Value::from_double(-val.as_double());
+  error("expecting numeric operand for 'neg'", line, column);
+  return Value();
+}
+
+
+std::string Runtime::to_string(const Value& val) const
+{
+  char buf[32];
+  switch(val.kind()) {
+    case V_INT: return std::string(buf, format_int(val.as_int(), buf));
+    case V_DOUBLE: return std::string(buf, format_double(val.as_double(), buf));
+    case V_BOOL: return val.as_bool() ? "true" : "false";
+    case V_CHAR: return std::string(1, val.as_char());
+    case V_STRING: return val.as_string();
+    case V_OBJECT: return "<" + types[val.as_object()->type_id].name + ">";
+    default: return "nil";
+  }
+}
+
+
+int Runtime::format_int(int val, char* buf)
+{
+  static const char pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+  // the digits are written backwards from the end of tmp, two at a time
+  char tmp[12];
+  char* p = tmp + sizeof(tmp);
+  unsigned u = val < 0 ? 0u - (unsigned)val : val;
+  while (u >= 100) {
+    unsigned d = (u % 100) * 2;
+    u /= 100;
+    *--p = pairs[d + 1];
+    *--p = pairs[d];
+  }
+  if (u >= 10) {
+    *--p = pairs[u * 2 + 1];
+    *--p = pairs[u * 2];
+  }
+  else
+    *--p = '0' + u;
+  if (val < 0)
+    *--p = '-';
+  int n = tmp + sizeof(tmp) - p;
+  std::memcpy(buf, p, n);
+  return n;
+}
+
+
+int Runtime::format_double(double val, char* buf)
+{
+  return std::snprintf(buf, 32, "%g", val);
+}
+
+
+void Runtime::flush()
+{
+  out.write(output.data(), output.size());
+  out.flush();
+  output.clear();
+}
+
+
+void Runtime::write(const char* s, size_t n)
+{
+  if (output.capacity() < OUTPUT_BUFFER_SIZE)
+    output.reserve(OUTPUT_BUFFER_SIZE);
+  output.append(s, n);
+  if (output.size() >= OUTPUT_BUFFER_SIZE)
+    flush();
+}
+
+
+// append a value's string to the output (without building it)
+void Runtime::print(const Value& val)
+{
+  char buf[32];
+  switch(val.kind()) {
+    case V_INT: write(buf, format_int(val.as_int(), buf)); break;
+    case V_DOUBLE: write(buf, format_double(val.as_double(), buf)); break;
+    case V_CHAR: buf[0] = val.as_char(); write(buf, 1); break;
+    case V_STRING: {
+      const std::string& s = val.as_string();
+      write(s.data(), s.size());
+      break;
+    }
+    default: {
+      std::string s = to_string(val);
+      write(s.data(), s.size());
+    }
+  }
+}
+
+
+Value Runtime::literal(const Token& token)
+{
+  const std::string& s = token.lexeme();
+  switch(token.type()) {
+    case INT_VAL: return Value::from_int(std::stoi(s));
+    case DOUBLE_VAL: return Value::from_double(std::stod(s));
+    case BOOL_VAL: return Value::from_bool(s == "true");
+    case CHAR_VAL: return Value::from_char(s[0]);
+    case STRING_VAL: return Value::intern(unescape(s));
+    default: return Value();
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Built-In Functions
+//----------------------------------------------------------------------
+
+
+int Runtime::builtin_id(const std::string& name)
+{
+  for (int i = 0; i < BUILTIN_COUNT; ++i)
+    if (name == builtin_names[i])
+      return i;
+  return -1;
+}
+
+
+Value Runtime::call_builtin(int id, const Value* args, int argc, int line, int column)
+{
+  static const int arity[] = {1, 0, 1, 2, 2, 1, 1, 1, 1};
+  // (the name is only made a string for errors)
+  const char* name = builtin_names[id];
+  if (argc != arity[id])
+    error(std::string("wrong number of arguments to '") + name + "'", line, column);
+  switch(id) {
+    case B_PRINT:
+      print(args[0]);
+      return Value();
+    case B_READ: {
+      flush();
+      std::string s;
+      std::getline(std::cin, s);
+      return Value::make_string(s);
+    }
+    case B_LENGTH:
+      if (not args[0].is_string())
+        error("expecting string argument to 'length'", line, column);
+      return Value::from_int(args[0].string_size());
+    case B_GET: {
+      if (not args[0].is_int() or not args[1].is_string())
+        error("expecting int and string arguments to 'get'", line, column);
+      const std::string& s = args[1].as_string();
+      int i = args[0].as_int();
+      if (i < 0 or i >= (int)s.size())
+        error("index out of range in 'get'", line, column);
+      return Value::from_char(s[i]);
+    }
+    case B_CONCAT:
+      if (not args[0].is_string() or not args[1].is_string())
+        error("expecting string arguments to 'concat'", line, column);
+      return Value::concat(args[0], args[1]);
+    case B_ITOS:
+    case B_DTOS:
+      if (not (id == B_ITOS ? args[0].is_int() : args[0].is_double()))
+        error(std::string("invalid argument to '") + name + "'", line, column);
+      return Value::from_string(to_string(args[0]));
+    default:
+      if (not args[0].is_string())
+        error(std::string("expecting string argument to '") + name + "'", line, column);
+      try {
+        if (id == B_STOI)
+          return Value::from_int(std::stoi(args[0].as_string()));
+        return Value::from_double(std::stod(args[0].as_string()));
+      } catch (std::exception&) {
+        error(std::string("invalid numeric string in '") + name + "'", line, column);
+      }
+  }
+  return Value();
+}
+
+
+#endif
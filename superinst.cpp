@@ -0,0 +1,190 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: superinst.cpp
+// DATE: 10/19/2026
+// DESC: Superinstruction generator. Runs the benchmark programs on the
+//       VM without superinstructions, counting how often each fusable
+//       sequence of 2 or 3 instructions runs, and writes the ones that
+//       save the most dispatches to the given superinstructions.h
+//       (-o). Also reports the dispatches saved by the superinstructions
+//       the VM was built with.
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <string>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "runtime.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "vm.h"
+
+using namespace std;
+
+#ifndef BENCH_DIR
+#define BENCH_DIR "bench"
+#endif
+
+
+// the programs profiled when none are given on the command line
+const vector<string> default_programs = {"fib.mypl", "loops.mypl", "list.mypl",
+                                         "arith.mypl"};
+
+// longest sequence considered
+const size_t max_length = 3;
+
+
+// parse the given file into the program node
+void parse_file(const string& path, Program& program)
+{
+  ifstream input(path);
+  if (not input)
+    throw MyPLException(RUNTIME, "unable to open '" + path + "'", 0, 0);
+  Lexer lexer(input);
+  Parser parser(lexer);
+  parser.parse(program);
+}
+
+
+// run the program on the VM, returning the instructions dispatched (and
+// adding its sequence counts if given)
+long profile(Program& program, bool fused,
+             map<vector<uint8_t>,long>* counts = nullptr)
+{
+  Module module;
+  Compiler compiler(module);
+  program.accept(compiler);
+  ostringstream out;
+  Runtime runtime(out);
+  VM vm(runtime, module);
+  vm.count_instructions(true);
+  vm.use_superinstructions(fused);
+  vm.run();
+  if (counts)
+    vm.sequence_counts(*counts, max_length);
+  return vm.instructions();
+}
+
+
+string sequence_name(const vector<uint8_t>& seq)
+{
+  string name;
+  for (uint8_t op : seq)
+    name += (name.empty() ? "" : " ") + string(op_info[op].name);
+  return name;
+}
+
+
+// write the header defining the given superinstructions
+void write_header(ostream& out, const vector<vector<uint8_t>>& chosen)
+{
+  out << "//----------------------------------------------------------------------\n"
+      << "// FILE: superinstructions.h\n"
+      << "// DESC: Superinstructions fused by the VM, generated by superinst\n"
+      << "//       from the benchmark programs (do not edit). Each entry is the\n"
+      << "//       sequence length followed by its instructions, longest first;\n"
+      << "//       the handlers are made of vm.h's BODY macros.\n"
+      << "//----------------------------------------------------------------------\n\n"
+      << "#ifndef SUPERINSTRUCTIONS_H\n#define SUPERINSTRUCTIONS_H\n\n"
+      << "#include <cstdint>\n#include \"bytecode.h\"\n\n"
+      << "#define SUPERINSTRUCTION_COUNT " << chosen.size() << "\n\n"
+      << "const uint8_t superinstructions[SUPERINSTRUCTION_COUNT + 1]["
+      << max_length + 1 << "] = {\n";
+  for (const vector<uint8_t>& seq : chosen) {
+    out << "  {" << seq.size();
+    for (uint8_t op : seq)
+      out << ", OP_" << op_info[op].name;
+    out << "},\n";
+  }
+  out << "  {0}\n};\n\n#define SUPERINSTRUCTION_LABELS";
+  for (size_t s = 0; s < chosen.size(); ++s)
+    out << (s ? "," : "") << " \\\n  &&L_SUPER_" << s;
+  out << "\n\n#define SUPERINSTRUCTION_HANDLERS";
+  for (size_t s = 0; s < chosen.size(); ++s) {
+    out << " \\\n  SUPER_TARGET(" << s << "):";
+    for (size_t k = 0; k < chosen[s].size(); ++k)
+      out << " BODY_" << op_info[chosen[s][k]].name << "(" << k << ")";
+    if (not VM::ends_superinstruction(chosen[s].back()))
+      out << " SUPER_NEXT(" << chosen[s].size() << ")";
+  }
+  out << "\n\n#endif\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+  size_t count = 16;
+  string header_path;
+  vector<string> programs;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-n" and i + 1 < argc)
+      count = stoi(argv[++i]);
+    else if (arg == "-o" and i + 1 < argc)
+      header_path = argv[++i];
+    else
+      programs.push_back(arg);
+  }
+  if (programs.empty())
+    for (const string& p : default_programs)
+      programs.push_back(string(BENCH_DIR) + "/" + p);
+
+  try {
+    map<vector<uint8_t>,long> counts;
+    vector<long> plain, fused;
+    for (const string& path : programs) {
+      Program program;
+      parse_file(path, program);
+      plain.push_back(profile(program, false, &counts));
+      fused.push_back(profile(program, true));
+    }
+
+    // rank the sequences by dispatches saved
+    vector<pair<long,vector<uint8_t>>> ranked;
+    for (auto& c : counts)
+      ranked.push_back(make_pair(c.second * (long)(c.first.size() - 1), c.first));
+    sort(ranked.rbegin(), ranked.rend());
+    if (ranked.size() > count)
+      ranked.resize(count);
+    cout << left << setw(40) << "sequence" << right << setw(14) << "runs"
+         << setw(14) << "saved" << endl;
+    vector<vector<uint8_t>> chosen;
+    for (auto& r : ranked) {
+      cout << left << setw(40) << sequence_name(r.second) << right << setw(14)
+           << counts[r.second] << setw(14) << r.first << endl;
+      chosen.push_back(r.second);
+    }
+    stable_sort(chosen.begin(), chosen.end(),
+                [](const vector<uint8_t>& a, const vector<uint8_t>& b)
+                {return a.size() > b.size();});
+    if (header_path.size()) {
+      ofstream header(header_path);
+      write_header(header, chosen);
+      cout << "wrote " << chosen.size() << " superinstructions to "
+           << header_path << " (rebuild to use them)" << endl;
+    }
+
+    // dispatches with the built-in superinstructions
+    cout << endl << SUPERINSTRUCTION_COUNT << " superinstructions built in" << endl
+         << left << setw(14) << "program" << right << setw(14) << "plain"
+         << setw(14) << "fused" << setw(12) << "reduction" << endl;
+    for (size_t i = 0; i < programs.size(); ++i) {
+      string name = programs[i].substr(programs[i].find_last_of('/') + 1);
+      cout << left << setw(14) << name << right << setw(14) << plain[i]
+           << setw(14) << fused[i] << setw(11) << fixed << setprecision(1)
+           << 100.0 * (plain[i] - fused[i]) / plain[i] << "%" << endl;
+    }
+  } catch (MyPLException e) {
+    cout << e.to_string() << endl;
+    exit(1);
+  }
+}
@@ -0,0 +1,73 @@
+//----------------------------------------------------------------------
+// FILE: superinstructions.h
+// DESC: Superinstructions fused by the VM, generated by superinst
+//       from the benchmark programs (do not edit). Each entry is the
+//       sequence length followed by its instructions, longest first;
+//       the handlers are made of vm.h's BODY macros.
+//----------------------------------------------------------------------
+
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#include <cstdint>
+#include "bytecode.h"
+
+#define SUPERINSTRUCTION_COUNT 16
+
+const uint8_t superinstructions[SUPERINSTRUCTION_COUNT + 1][4] = {
+  {3, OP_CONST, OP_MOD, OP_STORE},
+  {3, OP_MOD, OP_STORE, OP_LOAD},
+  {3, OP_STORE, OP_LOAD, OP_LOAD},
+  {3, OP_LOAD, OP_CONST, OP_MUL},
+  {3, OP_ADD, OP_CONST, OP_MOD},
+  {3, OP_STORE, OP_LOAD, OP_CONST},
+  {3, OP_LOAD, OP_CONST, OP_MOD},
+  {3, OP_LOAD, OP_LOAD, OP_CONST},
+  {3, OP_MOD, OP_ADD, OP_CONST},
+  {3, OP_MUL, OP_CONST, OP_MOD},
+  {3, OP_CONST, OP_MOD, OP_ADD},
+  {2, OP_LOAD, OP_CONST},
+  {2, OP_CONST, OP_MOD},
+  {2, OP_STORE, OP_LOAD},
+  {2, OP_LOAD, OP_LOAD},
+  {2, OP_MOD, OP_STORE},
+  {0}
+};
+
+#define SUPERINSTRUCTION_LABELS \
+  &&L_SUPER_0, \
+  &&L_SUPER_1, \
+  &&L_SUPER_2, \
+  &&L_SUPER_3, \
+  &&L_SUPER_4, \
+  &&L_SUPER_5, \
+  &&L_SUPER_6, \
+  &&L_SUPER_7, \
+  &&L_SUPER_8, \
+  &&L_SUPER_9, \
+  &&L_SUPER_10, \
+  &&L_SUPER_11, \
+  &&L_SUPER_12, \
+  &&L_SUPER_13, \
+  &&L_SUPER_14, \
+  &&L_SUPER_15
+
+#define SUPERINSTRUCTION_HANDLERS \
+  SUPER_TARGET(0): BODY_CONST(0) BODY_MOD(1) BODY_STORE(2) SUPER_NEXT(3) \
+  SUPER_TARGET(1): BODY_MOD(0) BODY_STORE(1) BODY_LOAD(2) SUPER_NEXT(3) \
+  SUPER_TARGET(2): BODY_STORE(0) BODY_LOAD(1) BODY_LOAD(2) SUPER_NEXT(3) \
+  SUPER_TARGET(3): BODY_LOAD(0) BODY_CONST(1) BODY_MUL(2) SUPER_NEXT(3) \
+  SUPER_TARGET(4): BODY_ADD(0) BODY_CONST(1) BODY_MOD(2) SUPER_NEXT(3) \
+  SUPER_TARGET(5): BODY_STORE(0) BODY_LOAD(1) BODY_CONST(2) SUPER_NEXT(3) \
+  SUPER_TARGET(6): BODY_LOAD(0) BODY_CONST(1) BODY_MOD(2) SUPER_NEXT(3) \
+  SUPER_TARGET(7): BODY_LOAD(0) BODY_LOAD(1) BODY_CONST(2) SUPER_NEXT(3) \
+  SUPER_TARGET(8): BODY_MOD(0) BODY_ADD(1) BODY_CONST(2) SUPER_NEXT(3) \
+  SUPER_TARGET(9): BODY_MUL(0) BODY_CONST(1) BODY_MOD(2) SUPER_NEXT(3) \
+  SUPER_TARGET(10): BODY_CONST(0) BODY_MOD(1) BODY_ADD(2) SUPER_NEXT(3) \
+  SUPER_TARGET(11): BODY_LOAD(0) BODY_CONST(1) SUPER_NEXT(2) \
+  SUPER_TARGET(12): BODY_CONST(0) BODY_MOD(1) SUPER_NEXT(2) \
+  SUPER_TARGET(13): BODY_STORE(0) BODY_LOAD(1) SUPER_NEXT(2) \
+  SUPER_TARGET(14): BODY_LOAD(0) BODY_LOAD(1) SUPER_NEXT(2) \
+  SUPER_TARGET(15): BODY_MOD(0) BODY_STORE(1) SUPER_NEXT(2)
+
+#endif
@@ -0,0 +1,89 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: symbol_table.h
+// DATE: 10/19/2026
+// DESC: Nested environments mapping variable names to values for the
+//       AST interpreter. Environments are grouped into frames so that
+//       a function body only sees its own variables.
+//----------------------------------------------------------------------
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "data_object.h"
+
+
+class SymbolTable
+{
+public:
+  // add/remove an environment (block scope) in the current frame
+  void push_environment() {environments.emplace_back();}
+  void pop_environment() {environments.pop_back();}
+
+  // start a new frame (function call), returning the previous frame
+  // base to pass to pop_frame
+  size_t push_frame();
+  void pop_frame(size_t old_base);
+
+  // true if the name is visible in the current frame
+  bool name_exists(const std::string& name) const;
+
+  // add a new variable to the innermost environment
+  void add_name(const std::string& name, const DataObject& val);
+
+  // find the closest visible variable (nullptr if not visible)
+  DataObject* find(const std::string& name);
+
+private:
+  typedef std::unordered_map<std::string,DataObject> Environment;
+  std::vector<Environment> environments;
+  size_t frame_base = 0;
+};
+
+
+size_t SymbolTable::push_frame()
+{
+  size_t old_base = frame_base;
+  frame_base = environments.size();
+  push_environment();
+  return old_base;
+}
+
+
+void SymbolTable::pop_frame(size_t old_base)
+{
+  environments.resize(frame_base);
+  frame_base = old_base;
+}
+
+
+bool SymbolTable::name_exists(const std::string& name) const
+{
+  for (size_t i = environments.size(); i > frame_base; --i)
+    if (environments[i-1].count(name))
+      return true;
+  return false;
+}
+
+
+void SymbolTable::add_name(const std::string& name, const DataObject& val)
+{
+  environments.back()[name] = val;
+}
+
+
+DataObject* SymbolTable::find(const std::string& name)
+{
+  for (size_t i = environments.size(); i > frame_base; --i) {
+    auto it = environments[i-1].find(name);
+    if (it != environments[i-1].end())
+      return &it->second;
+  }
+  return nullptr;
+}
+
+
+#endif
@@ -0,0 +1,13 @@
+# runs a MyPL program (PROGRAM) with mypl (MYPL) and the given flags
+# (FLAGS, a list), and fails unless its output, with any error message,
+# is the program's expected output (the .out file beside it)
+
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+execute_process(COMMAND ${MYPL} ${flags} ${PROGRAM}
+                OUTPUT_VARIABLE output ERROR_VARIABLE output)
+string(REGEX REPLACE "\\.mypl$" ".out" expected_file ${PROGRAM})
+file(READ ${expected_file} expected)
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "unexpected output from ${PROGRAM} (${FLAGS}):\n"
+                      "${output}\nexpected:\n${expected}")
+endif()
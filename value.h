@@ -0,0 +1,360 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: value.h
+// DATE: 10/19/2026
+// DESC: Runtime value representation shared by the MyPL execution
+//       engines. Values are NaN-boxed into 8 bytes: doubles are stored
+//       as themselves and the other kinds in the payload of a negative
+//       quiet NaN with a nonzero 3-bit tag, so a type test is one mask
+//       and compare. Strings are immutable and reference counted.
+//       Long concatenations make rope nodes, flattened when first
+//       read, so strings built up in loops take linear time. Literals
+//       and short identifier-like strings are interned, so comparing
+//       two of them is a pointer comparison. Defining MYPL_FAT_VALUES
+//       selects the original tagged union (with an inline std::string)
+//       instead, for comparison.
+//----------------------------------------------------------------------
+
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+
+#ifndef MYPL_FAT_VALUES
+#define MYPL_FAT_VALUES 0
+#endif
+
+
+// the kinds of runtime values
+enum ValueKind {V_NIL, V_INT, V_DOUBLE, V_BOOL, V_CHAR, V_STRING, V_OBJECT};
+
+
+struct Object;
+
+
+// strings up to this long that look like identifiers are interned
+const size_t SMALL_STRING = 15;
+
+// concatenations at least this long make rope nodes
+const size_t ROPE_MIN = 64;
+
+
+bool identifier_like(const std::string& s)
+{
+  if (s.empty() or s.size() > SMALL_STRING or std::isdigit((unsigned char)s[0]))
+    return false;
+  for (char c : s)
+    if (not std::isalnum((unsigned char)c) and c != '_')
+      return false;
+  return true;
+}
+
+
+#if MYPL_FAT_VALUES
+
+class Value
+{
+public:
+  // nil by default
+  Value() : value_kind(V_NIL) {int_val = 0;}
+
+  // constructors for each kind
+  static Value from_int(int v) {Value r; r.value_kind = V_INT; r.int_val = v; return r;}
+  static Value from_double(double v)
+    {Value r; r.value_kind = V_DOUBLE; r.double_val = v; return r;}
+  static Value from_bool(bool v) {Value r; r.value_kind = V_BOOL; r.bool_val = v; return r;}
+  static Value from_char(char v) {Value r; r.value_kind = V_CHAR; r.char_val = v; return r;}
+  static Value from_string(const std::string& v)
+    {Value r; r.value_kind = V_STRING; r.string_val = v; return r;}
+  static Value from_object(Object* v)
+    {Value r; r.value_kind = V_OBJECT; r.object_val = v; return r;}
+
+  // strings (made as from_string makes them in this representation)
+  static Value intern(const std::string& v) {return from_string(v);}
+  static Value make_string(const std::string& v) {return from_string(v);}
+  static Value concat(const Value& lhs, const Value& rhs)
+    {return from_string(lhs.string_val + rhs.string_val);}
+  static bool string_equal(const Value& lhs, const Value& rhs)
+    {return lhs.string_val == rhs.string_val;}
+  size_t string_size() const {return string_val.size();}
+
+  // type tests
+  ValueKind kind() const {return value_kind;}
+  bool is_nil() const {return value_kind == V_NIL;}
+  bool is_int() const {return value_kind == V_INT;}
+  bool is_double() const {return value_kind == V_DOUBLE;}
+  bool is_bool() const {return value_kind == V_BOOL;}
+  bool is_char() const {return value_kind == V_CHAR;}
+  bool is_string() const {return value_kind == V_STRING;}
+  bool is_object() const {return value_kind == V_OBJECT;}
+
+  // accessors (caller must check the kind first)
+  int as_int() const {return int_val;}
+  double as_double() const {return double_val;}
+  bool as_bool() const {return bool_val;}
+  char as_char() const {return char_val;}
+  const std::string& as_string() const {return string_val;}
+  Object* as_object() const {return object_val;}
+
+  // the object referred to, or null
+  Object* load_object() const {return is_object() ? object_val : nullptr;}
+
+private:
+  ValueKind value_kind;
+  union {
+    int int_val;
+    double double_val;
+    bool bool_val;
+    char char_val;
+    Object* object_val;
+  };
+  std::string string_val;
+};
+
+
+#else
+
+// a shared immutable string: either flat (value holds it, inline in
+// the std::string when short) or a rope node for the concatenation of
+// left and right, which is flattened into value when first read
+struct StringObject
+{
+  long refs;
+  size_t length;
+  bool interned;
+  StringObject* left;
+  StringObject* right;
+  std::string value;
+};
+
+
+struct StringObjectHash
+{
+  size_t operator()(const StringObject* s) const
+    {return std::hash<std::string>()(s->value);}
+};
+
+
+struct StringObjectEqual
+{
+  bool operator()(const StringObject* a, const StringObject* b) const
+    {return a->value == b->value;}
+};
+
+
+// the interned strings (each removed when its last reference goes)
+std::unordered_set<StringObject*,StringObjectHash,StringObjectEqual>& interned_strings()
+{
+  static std::unordered_set<StringObject*,StringObjectHash,StringObjectEqual> strings;
+  return strings;
+}
+
+
+// delete an unreferenced string and the rope nodes only it referenced
+void free_string(StringObject* s)
+{
+  std::vector<StringObject*> work;
+  while (true) {
+    if (s->interned)
+      interned_strings().erase(s);
+    if (s->left) {
+      for (StringObject* child : {s->left, s->right})
+        if (--child->refs == 0)
+          work.push_back(child);
+    }
+    delete s;
+    if (work.empty())
+      return;
+    s = work.back();
+    work.pop_back();
+  }
+}
+
+
+// copy a rope's leaves into its value and drop its children (with a
+// work list, as ropes built in loops are deep)
+void flatten(StringObject* rope)
+{
+  std::string flat;
+  flat.reserve(rope->length);
+  std::vector<StringObject*> work(1, rope);
+  while (not work.empty()) {
+    StringObject* s = work.back();
+    work.pop_back();
+    if (s->left) {
+      work.push_back(s->right);
+      work.push_back(s->left);
+    }
+    else
+      flat += s->value;
+  }
+  for (StringObject* child : {rope->left, rope->right})
+    if (--child->refs == 0)
+      free_string(child);
+  rope->left = rope->right = nullptr;
+  rope->value = std::move(flat);
+}
+
+
+class Value
+{
+public:
+  // nil by default
+  Value() : bits(box(V_NIL)) {}
+
+  // copies share strings
+  Value(const Value& other) : bits(other.bits) {retain();}
+  Value(Value&& other) noexcept : bits(other.bits) {other.bits = box(V_NIL);}
+  Value& operator=(const Value& other)
+    {other.retain(); release(); bits = other.bits; return *this;}
+  Value& operator=(Value&& other) noexcept
+    {std::swap(bits, other.bits); return *this;}
+  ~Value() {release();}
+
+  // constructors for each kind (NaNs keep only their sign, and the
+  // negative one is signaling, so they are never mistaken for boxed
+  // values)
+  static Value from_int(int v) {return Value(box(V_INT) | (uint32_t)v);}
+  static Value from_double(double v)
+  {
+    uint64_t b;
+    std::memcpy(&b, &v, 8);
+    return Value(v == v ? b : (b & SIGN) ? NEGATIVE_NAN : POSITIVE_NAN);
+  }
+  static Value from_bool(bool v) {return Value(box(V_BOOL) | v);}
+  static Value from_char(char v) {return Value(box(V_CHAR) | (unsigned char)v);}
+  static Value from_string(const std::string& v)
+    {return string(new StringObject{1, v.size(), false, nullptr, nullptr, v});}
+  static Value from_object(Object* v) {return Value(box(V_OBJECT) | (uint64_t)v);}
+
+  // the unique (interned) string with the value v
+  static Value intern(const std::string& v)
+  {
+    StringObject key = {0, v.size(), false, nullptr, nullptr, v};
+    auto& strings = interned_strings();
+    auto it = strings.find(&key);
+    if (it != strings.end()) {
+      ++(*it)->refs;
+      return string(*it);
+    }
+    StringObject* s = new StringObject{1, v.size(), true, nullptr, nullptr, v};
+    strings.insert(s);
+    return string(s);
+  }
+
+  // a string made at run time (interned if short and identifier-like)
+  static Value make_string(const std::string& v)
+    {return identifier_like(v) ? intern(v) : from_string(v);}
+
+  // the concatenation of two strings (a rope node if it is long)
+  static Value concat(const Value& lhs, const Value& rhs)
+  {
+    StringObject* a = lhs.string_object();
+    StringObject* b = rhs.string_object();
+    if (b->length == 0)
+      return lhs;
+    if (a->length == 0)
+      return rhs;
+    size_t length = a->length + b->length;
+    if (length < ROPE_MIN)
+      return make_string(a->value + b->value);
+    ++a->refs;
+    ++b->refs;
+    return string(new StringObject{1, length, false, a, b, std::string()});
+  }
+
+  // whether two strings are equal (interned strings only if they are
+  // the same string)
+  static bool string_equal(const Value& lhs, const Value& rhs)
+  {
+    StringObject* a = lhs.string_object();
+    StringObject* b = rhs.string_object();
+    if (a == b)
+      return true;
+    if ((a->interned and b->interned) or a->length != b->length)
+      return false;
+    return lhs.as_string() == rhs.as_string();
+  }
+
+  // a string's length (without flattening it)
+  size_t string_size() const {return string_object()->length;}
+
+  // type tests
+  ValueKind kind() const
+    {return is_double() ? V_DOUBLE : (ValueKind)(((bits >> 48) & 7) - 1);}
+  bool is_nil() const {return (bits & TAG_MASK) == box(V_NIL);}
+  bool is_int() const {return (bits & TAG_MASK) == box(V_INT);}
+  bool is_double() const {return (bits & BOXED) != BOXED;}
+  bool is_bool() const {return (bits & TAG_MASK) == box(V_BOOL);}
+  bool is_char() const {return (bits & TAG_MASK) == box(V_CHAR);}
+  bool is_string() const {return (bits & TAG_MASK) == box(V_STRING);}
+  bool is_object() const {return (bits & TAG_MASK) == box(V_OBJECT);}
+
+  // accessors (caller must check the kind first)
+  int as_int() const {return (int)(uint32_t)bits;}
+  double as_double() const {double d; std::memcpy(&d, &bits, 8); return d;}
+  bool as_bool() const {return bits & 1;}
+  char as_char() const {return (char)(bits & 0xFF);}
+  const std::string& as_string() const
+  {
+    StringObject* s = string_object();
+    if (s->left)
+      flatten(s);
+    return s->value;
+  }
+  Object* as_object() const {return (Object*)(bits & PAYLOAD);}
+
+  // the object referred to, or null (reading the value once, so another
+  // thread can be storing to it)
+  Object* load_object() const
+  {
+    uint64_t b = *(const volatile uint64_t*)&bits;
+    return (b & TAG_MASK) == box(V_OBJECT) ? (Object*)(b & PAYLOAD) : nullptr;
+  }
+
+private:
+  // the sign, exponent and quiet bits mark a boxed value, and the next
+  // 3 bits are its kind plus 1 (the payload holds 48-bit pointers)
+  static const uint64_t BOXED = 0xFFF8000000000000ull;
+  static const uint64_t SIGN = 0x8000000000000000ull;
+  static const uint64_t POSITIVE_NAN = 0x7FF8000000000000ull;
+  static const uint64_t NEGATIVE_NAN = 0xFFF4000000000000ull;
+  static const uint64_t TAG_MASK = 0xFFFF000000000000ull;
+  static const uint64_t PAYLOAD = 0x0000FFFFFFFFFFFFull;
+  static constexpr uint64_t box(ValueKind kind) {return BOXED | (uint64_t)(kind + 1) << 48;}
+
+  explicit Value(uint64_t b) : bits(b) {}
+  static Value string(StringObject* s) {return Value(box(V_STRING) | (uint64_t)s);}
+  StringObject* string_object() const {return (StringObject*)(bits & PAYLOAD);}
+  void retain() const {if (is_string()) ++string_object()->refs;}
+  void release()
+    {if (is_string() and --string_object()->refs == 0) free_string(string_object());}
+
+  uint64_t bits;
+};
+
+static_assert(sizeof(Value) == 8, "values are NaN-boxed into 8 bytes");
+
+#endif
+
+
+// a struct instance: a header followed by its fields (in type
+// declaration order), allocated by the heap (see heap.h)
+struct Object
+{
+  int type_id;
+  int field_count;
+
+  Value* fields() {return reinterpret_cast<Value*>(this + 1);}
+};
+
+static_assert(sizeof(Object) % alignof(Value) == 0, "fields follow the header");
+
+
+#endif
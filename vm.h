@@ -0,0 +1,2013 @@
+//----------------------------------------------------------------------
+// NAME: Joshua Seward
+// FILE: vm.h
+// DATE: 10/19/2026
+// DESC: Stack-based virtual machine for MyPL bytecode (see
+//       bytecode.h). Frames live on one contiguous value stack, each
+//       holding its local slots followed by its operands, and a call's
+//       arguments become the callee's first locals in place (so calls
+//       do not allocate). Functions are decoded when first called into
+//       fixed-size instructions (so loading a mapped image only touches
+//       the code that runs, see image.h), and when built with MYPL_THREADED
+//       (GCC/Clang labels as values) each instruction holds its
+//       handler's address and every handler jumps directly to the next
+//       (direct threading). Otherwise a switch dispatches. Frequent
+//       instruction sequences (see superinstructions.h) are fused at
+//       decode time into single superinstructions, and arithmetic and
+//       comparison instructions are rewritten when first run into
+//       forms specialized for their operand types (quickening).
+//       The value stack is the object heap's root set (heap.h): every
+//       slot of every frame holds a tagged value, and the slots above
+//       the top are nil, so the stack up to the top is an exact map of
+//       the references the frames hold. Objects that do not escape
+//       their function (see escape.h) are allocated in an area the
+//       frame reserves on a separate object stack when it is called
+//       and releases when it returns; the collector never sees them,
+//       only the references their fields hold. In region mode every
+//       object is allocated the same way, after the frame's own, so a
+//       call's temporaries are freed all at once when it returns (and
+//       until then the collector only visits the fields of those still
+//       referenced, so dead ones keep no heap objects alive). A
+//       region object stays referenced only from its frame and the ones
+//       it calls: one returned, or stored in a heap object or an older
+//       frame's, escapes and is moved to the heap with every region
+//       object it reaches (and a function whose objects escape often
+//       goes back to allocating on the heap). In JIT mode a function
+//       called or looping often enough is compiled to x86-64 machine
+//       code (see jit.h) that works on the same stack and frames, so
+//       the interpreter enters it after calls, returns and backward
+//       jumps, and it exits back to the interpreter at any instruction
+//       it does not handle (calls, returns, and operands of other
+//       types than its fast paths take).
+//----------------------------------------------------------------------
+
+#ifndef VM_H
+#define VM_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <new>
+#include <memory>
+#include <exception>
+#include "runtime.h"
+#include "bytecode.h"
+#include "image.h"
+#include "superinstructions.h"
+#include "jit.h"
+
+#ifndef MYPL_THREADED
+#if defined(__GNUC__)
+#define MYPL_THREADED 1
+#else
+#define MYPL_THREADED 0
+#endif
+#endif
+
+
+// the quickened forms of the arithmetic and comparison instructions
+// (numbered after the superinstructions), each guarded by a check of
+// its operand types
+enum QuickOp : uint8_t {
+  Q_ADD_INT = OP_COUNT + SUPERINSTRUCTION_COUNT, Q_SUB_INT, Q_MUL_INT,
+  Q_DIV_INT, Q_MOD_INT, Q_EQ_INT, Q_NE_INT, Q_LT_INT, Q_LE_INT, Q_GT_INT,
+  Q_GE_INT,
+  Q_ADD_DOUBLE, Q_SUB_DOUBLE, Q_MUL_DOUBLE, Q_DIV_DOUBLE, Q_EQ_DOUBLE,
+  Q_NE_DOUBLE, Q_LT_DOUBLE, Q_LE_DOUBLE, Q_GT_DOUBLE, Q_GE_DOUBLE,
+  Q_EQ_STRING, Q_NE_STRING,
+  QUICK_END
+};
+
+
+class VM : public RootSource
+{
+public:
+  // load the module's types and functions into the runtime
+  VM(Runtime& runtime, const Module& program_module);
+  ~VM();
+  VM(const VM&) = delete;
+  VM& operator=(const VM&) = delete;
+
+  // run the program's main function
+  void run();
+
+  // count the instructions dispatched by run (off by default)
+  void count_instructions(bool on) {counting = on;}
+  long instructions() const {return instruction_count;}
+
+  // fuse instruction sequences into superinstructions (on by default)
+  void use_superinstructions(bool on) {fusing = on;}
+
+  // allocate objects in the calls' regions (off by default), and the
+  // number allocated there and moved to the heap by escaping
+  void use_regions(bool on) {regions = on;}
+  long region_objects() const {return region_count;}
+  long escaped_objects() const {return escaped_count;}
+
+  // compile hot functions to machine code and run that (off by
+  // default, and only when MYPL_JIT), and the number compiled
+  void use_jit(bool on) {jitting = on;}
+  long compiled_functions() const {return compiled_count;}
+
+  // add the number of times each fusable sequence of 2 to max_length
+  // instructions was run (by the last counted run without fusion)
+  void sequence_counts(std::map<std::vector<uint8_t>,long>& counts,
+                       size_t max_length) const;
+
+  // the instructions a superinstruction can be made of (the ones that
+  // end it can only come last)
+  static bool fusable(uint8_t op);
+  static bool ends_superinstruction(uint8_t op);
+
+  // mark the objects referenced from the value stack and the fields
+  // of the frames' objects
+  void mark_roots(Heap& heap);
+
+private:
+  // a decoded instruction (jump targets are instruction indexes); op
+  // is base, a superinstruction starting with base, or base quickened
+  // (b is set once a quickened instruction's guard fails, leaving it
+  // generic); field instructions cache the slot of their field in the
+  // last type they accessed (cache_type is its id + 1, 0 if empty);
+  // b is set on a NEW_LOCAL given a place in its frame's object area
+  // (cache_type is its offset in 8-byte words)
+  struct Instr
+  {
+    const void* handler;
+    uint16_t a;
+    uint8_t b;
+    uint8_t op;
+    uint8_t base;
+    uint8_t cache_slot;
+    uint16_t cache_type;
+  };
+
+  // a function's decoded code, with the bytecode offset of each
+  // instruction (for error positions), the jump targets, and how often
+  // each instruction was dispatched when counting (frame_size is the
+  // stack space for its locals and deepest operand stack, set once it
+  // is decoded, and object_bytes the size of the area holding its
+  // NEW_LOCAL objects, at each local object's offset; in region mode
+  // its objects are counted, and the ones that escaped; hotness counts
+  // its calls and backward jumps, and once compiled it has native code
+  // with the address to enter it at for each instruction)
+  struct LocalObject
+  {
+    int offset;
+    int type_id;
+  };
+  struct LoadedFunction
+  {
+    const Function* source;
+    bool decoded = false;
+    int frame_size;
+    int object_bytes = 0;
+    std::vector<LocalObject> objects;
+    long region_objects = 0;
+    long escaped_objects = 0;
+    long hotness = 0;
+#if MYPL_JIT
+    std::unique_ptr<ExecutableCode> native;
+    std::vector<const uint8_t*> entries;
+#endif
+    std::vector<Instr> code;
+    std::vector<int> offsets;
+    std::vector<bool> targets;
+    std::vector<long> counts;
+  };
+
+  // a function activation (locals points into the value stack,
+  // objects to its object area, null if it has none, and region to
+  // where its part of the object stack starts)
+  struct Frame
+  {
+    LoadedFunction* fun;
+    Instr* ip;
+    Value* locals;
+    char* objects;
+    char* region;
+  };
+
+  Runtime& rt;
+  const Module& module;
+
+  std::vector<LoadedFunction> functions;
+
+  // the constants (an image's are copied out as code using them is
+  // decoded)
+  const Value* constants;
+  std::vector<Value> image_constants;
+  std::vector<bool> materialized;
+
+  // the handler table the decoded code is bound to, and whether its
+  // superinstructions are fused
+  const void* const* bound_handlers = nullptr;
+  bool fusing = true;
+  bool fused = false;
+
+  // the value stack (the values above the top are nil), extended by
+  // STACK_CHUNK values at a time when a call would pass its end
+  static const size_t STACK_CHUNK = 16384;
+  Value* stack = nullptr;
+  Value* stack_end = nullptr;
+  std::vector<Frame> frames;
+
+  // the stack top when an object was last allocated (the only time a
+  // collection can happen)
+  Value* gc_top = nullptr;
+
+  // the frames' object areas and regions (a frame whose area does not
+  // fit, or a function needing more than FRAME_OBJECTS bytes, allocates
+  // its objects on the heap instead, as does a frame whose region has
+  // reached FRAME_REGION bytes)
+  static const size_t OBJECT_STACK = 1 << 22;
+  static const size_t FRAME_OBJECTS = 1 << 16;
+  static const size_t FRAME_REGION = 1 << 18;
+  char* object_stack = nullptr;
+  char* object_top = nullptr;
+
+  // region mode (a function stops using regions once more than 1 in
+  // ESCAPE_RATIO of its objects escaped), and the heap copies of the
+  // objects escaping
+  static const long ESCAPE_RATIO = 8;
+  bool regions = false;
+  long region_count = 0;
+  long escaped_count = 0;
+  std::vector<Value> escaping;
+
+  // JIT mode: a function is compiled once its hotness reaches
+  // JIT_THRESHOLD (an exception thrown in a runtime function its code
+  // calls is kept in pending until the code exits)
+  static const long JIT_THRESHOLD = 1000;
+  bool jitting = false;
+  long compiled_count = 0;
+  std::exception_ptr pending;
+
+  bool counting = false;
+  long instruction_count = 0;
+
+  // helper functions
+  template<bool Count> void execute();
+  void decode(LoadedFunction& fun);
+  static int max_depth(const LoadedFunction& fun, bool checking);
+  void grow(Value*& sp, size_t needed);
+  void fuse(LoadedFunction& fun);
+  void bind(const void* const* handlers);
+  bool operands_valid(const Instr& in, const Function& fun) const;
+  void error(const std::string& msg, const Frame& frame, const Instr* ip);
+  Position position(const Frame& frame, const Instr* ip);
+  void call(LoadedFunction& fun, Value*& sp, int argc);
+  void push_objects(Frame& frame);
+  void pop_objects(const Frame& frame);
+  bool local(const Object* obj) const;
+  static size_t object_size(int field_count);
+  Object* region_allocate(Frame& frame, int type_id);
+  const Frame& owner(const Object* obj) const;
+  bool outlives(const Object* holder, const Object* obj) const;
+  void store(Object* obj, int i, Value& val, Value* sp);
+  void escape(Value& val, Value* sp);
+  void allocate(Frame& frame, const Instr& in, Value* sp);
+  int cached_field(Object* obj, Instr& in);
+  int field(Object* obj, Instr& in, const Frame& frame);
+
+#if MYPL_JIT
+  // native code returns the stack top and the instruction to continue
+  // interpreting at (-1 for the pending exception)
+  struct NativeExit
+  {
+    Value* sp;
+    long index;
+  };
+  void compile(LoadedFunction& fun);
+  Instr* run_native(Frame& frame, Instr* ip, Value*& sp);
+  static uint64_t bits(const Value& v);
+  static void native_copy(Value* dst, const Value* src);
+  static void native_release(Value* v);
+  static long native_getfield(VM* vm, Instr* in, Value* sp);
+  static long native_setfield(VM* vm, Instr* in, Value* sp);
+  static long native_new(VM* vm, Instr* in, Value* sp);
+  static long native_builtin(VM* vm, Instr* in, Value* sp);
+#endif
+};
+
+
+VM::VM(Runtime& runtime, const Module& program_module)
+  : rt(runtime), module(program_module)
+{
+  for (const TypeDef& t : module.types)
+    rt.add_type(t.name, t.fields);
+  functions.resize(module.functions.size());
+  for (size_t i = 0; i < functions.size(); ++i)
+    functions[i].source = &module.functions[i];
+  constants = module.constants.data();
+  if (module.image) {
+    image_constants.resize(module.image->constant_count());
+    materialized.resize(image_constants.size());
+    constants = image_constants.data();
+  }
+  stack = new Value[STACK_CHUNK];
+  stack_end = stack + STACK_CHUNK;
+  frames.reserve(256);
+  gc_top = stack;
+  object_stack = object_top = static_cast<char*>(::operator new(OBJECT_STACK));
+  rt.heap().set_roots(this);
+}
+
+
+VM::~VM()
+{
+  rt.heap().set_roots(nullptr);
+  if (not frames.empty())
+    pop_objects(frames.front());
+  ::operator delete(object_stack);
+  delete[] stack;
+}
+
+
+//----------------------------------------------------------------------
+// Helper Functions
+//----------------------------------------------------------------------
+
+
+// decode a function's bytecode, fused and bound as the decoded code
+// is (code from an image is checked to be well formed)
+void VM::decode(LoadedFunction& loaded)
+{
+  const Function& fun = *loaded.source;
+  const uint8_t* code = fun.bytes();
+  int size = fun.size();
+  bool checking = module.image != nullptr;
+  auto check = [&](bool ok) {
+    if (not ok)
+      throw MyPLException(RUNTIME, "invalid code in function '" + fun.name + "'", 0, 0);
+  };
+  std::vector<int> index(size + 1, -1);
+  for (int i = 0; i < size; i += instruction_size(code[i])) {
+    if (checking)
+      check(code[i] < OP_COUNT and i + instruction_size(code[i]) <= size);
+    index[i] = loaded.offsets.size();
+    loaded.offsets.push_back(i);
+  }
+  index[size] = loaded.offsets.size();
+  loaded.targets.resize(loaded.offsets.size() + 1);
+  for (int offset : loaded.offsets) {
+    const uint8_t* p = code + offset;
+    Instr in = {nullptr, 0, 0, p[0], p[0], 0, 0};
+    switch(op_info[in.op].format) {
+      case U8_ARG: in.a = p[1]; break;
+      case U16_ARG: in.a = read_u16(p + 1); break;
+      case U16_U8_ARGS: in.a = read_u16(p + 1); in.b = p[3]; break;
+      default: break;
+    }
+    if (in.op >= OP_JUMP and in.op <= OP_FOR_LOOP) {
+      if (checking)
+        check(in.a < size and index[in.a] >= 0);
+      in.a = index[in.a];
+      loaded.targets[in.a] = true;
+    }
+    if (checking)
+      check(operands_valid(in, fun));
+    if (module.image and (in.op == OP_CONST or in.op == OP_ERROR) and
+        not materialized[in.a]) {
+      image_constants[in.a] = module.image->constant(in.a);
+      materialized[in.a] = true;
+    }
+    // (objects of types with an init function are passed to it, so
+    // they are always allocated on the heap)
+    if (in.op == OP_NEW_LOCAL and module.types[in.a].init_function < 0) {
+      size_t bytes = object_size(module.types[in.a].fields.size());
+      if (loaded.object_bytes + bytes <= FRAME_OBJECTS) {
+        LocalObject obj = {loaded.object_bytes, in.a};
+        loaded.objects.push_back(obj);
+        in.b = 1;
+        in.cache_type = loaded.object_bytes / 8;
+        loaded.object_bytes += bytes;
+      }
+    }
+    loaded.code.push_back(in);
+  }
+  if (checking)
+    check(loaded.code.back().op == OP_RETURN or loaded.code.back().op == OP_JUMP or
+          loaded.code.back().op == OP_ERROR);
+  loaded.counts.resize(loaded.code.size());
+  int depth = max_depth(loaded, checking);
+  if (checking)
+    check(depth >= 0);
+  loaded.frame_size = fun.local_count + depth;
+  loaded.decoded = true;
+  if (bound_handlers or fused) {
+    fuse(loaded);
+    for (Instr& in : loaded.code)
+      in.handler = bound_handlers ? bound_handlers[in.op] : nullptr;
+  }
+}
+
+
+// whether an instruction's indexes are in range (for checking code
+// from images)
+bool VM::operands_valid(const Instr& in, const Function& fun) const
+{
+  switch(in.op) {
+    case OP_CONST: return in.a < image_constants.size();
+    case OP_ERROR:
+      return in.a < image_constants.size() and
+        module.image->constant(in.a).kind() == V_STRING;
+    case OP_LOAD: case OP_STORE: return in.a < fun.local_count;
+    case OP_NEW: case OP_NEW_LOCAL: return in.a < module.types.size();
+    case OP_GETFIELD: case OP_SETFIELD: case OP_SETFIELD_LOCAL:
+      return in.a < module.names.size();
+    case OP_FOR_PREP: case OP_FOR_LOOP: return in.b + 1 < fun.local_count;
+    case OP_CALL:
+      return in.a < module.functions.size() and
+        module.functions[in.a].param_count == in.b;
+    case OP_BUILTIN: return in.a < BUILTIN_COUNT;
+    default: return true;
+  }
+}
+
+
+// the deepest the operand stack gets in a function (the compiler keeps
+// the stack balanced, so each instruction has one depth however it is
+// reached), or -1 if checking and the code does not keep it balanced:
+// an instruction takes more operands than the stack holds, or is
+// reached at two different depths
+int VM::max_depth(const LoadedFunction& fun, bool checking)
+{
+  std::vector<int> depth(fun.code.size(), -1);
+  std::vector<int> work(1, 0);
+  depth[0] = 0;
+  int deepest = 0;
+  while (not work.empty()) {
+    int i = work.back();
+    work.pop_back();
+    const Instr& in = fun.code[i];
+    int d = depth[i];
+    // the operands the instruction takes, and the depth after it and
+    // at its jump target
+    int taken = 0, next = d, target = -1;
+    switch(in.base) {
+      case OP_NIL: case OP_TRUE: case OP_FALSE: case OP_CONST: case OP_LOAD:
+      case OP_NEW: case OP_NEW_LOCAL:
+        next = d + 1;
+        break;
+      case OP_DUP:
+        taken = 1;
+        next = d + 1;
+        break;
+      case OP_STORE: case OP_POP:
+        taken = 1;
+        next = d - 1;
+        break;
+      case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+      case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+        taken = 2;
+        next = d - 1;
+        break;
+      case OP_GETFIELD: case OP_NOT: case OP_NEG:
+        taken = 1;
+        break;
+      case OP_SETFIELD: case OP_SETFIELD_LOCAL:
+        taken = 2;
+        next = d - 2;
+        break;
+      case OP_JUMP:
+        next = -1;
+        target = d;
+        break;
+      case OP_JUMP_IF_FALSE:
+        taken = 1;
+        next = target = d - 1;
+        break;
+      case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+        taken = 1;
+        next = d - 1;
+        target = d;
+        break;
+      case OP_FOR_PREP:
+        taken = 2;
+        next = target = d - 2;
+        break;
+      case OP_FOR_LOOP:
+        target = d;
+        break;
+      case OP_CALL: case OP_BUILTIN:
+        taken = in.b;
+        next = d - in.b + 1;
+        break;
+      case OP_RETURN:
+        taken = 1;
+        next = -1;
+        break;
+      case OP_ERROR:
+        next = -1;
+        break;
+      default:
+        break;
+    }
+    if (checking and taken > d)
+      return -1;
+    deepest = std::max(deepest, std::max(next, target));
+    if (next >= 0 and i + 1 < (int)depth.size()) {
+      if (depth[i+1] < 0) {
+        depth[i+1] = next;
+        work.push_back(i + 1);
+      }
+      else if (checking and depth[i+1] != next)
+        return -1;
+    }
+    if (target >= 0) {
+      if (depth[in.a] < 0) {
+        depth[in.a] = target;
+        work.push_back(in.a);
+      }
+      else if (checking and depth[in.a] != target)
+        return -1;
+    }
+  }
+  return deepest;
+}
+
+
+// replace each sequence matching a superinstruction (trying them in
+// table order) by the superinstruction, unless it is jumped into; the
+// instructions after the first are kept for the fused handler's
+// operands and for falling back
+void VM::fuse(LoadedFunction& fun)
+{
+  std::vector<Instr>& code = fun.code;
+  for (Instr& in : code)
+    in.op = in.base;
+  if (not fusing)
+    return;
+  size_t i = 0;
+  while (i < code.size()) {
+    size_t length = 1;
+    for (int s = 0; s < SUPERINSTRUCTION_COUNT; ++s) {
+      size_t n = superinstructions[s][0];
+      bool match = i + n <= code.size();
+      for (size_t k = 0; match and k < n; ++k)
+        match = code[i+k].base == superinstructions[s][k+1] and
+          (k == 0 or not fun.targets[i+k]);
+      if (match) {
+        code[i].op = OP_COUNT + s;
+        length = n;
+        break;
+      }
+    }
+    i += length;
+  }
+}
+
+
+// set each decoded instruction's handler address
+void VM::bind(const void* const* handlers)
+{
+  if (bound_handlers == handlers and fused == fusing)
+    return;
+  for (LoadedFunction& fun : functions) {
+    if (not fun.decoded)
+      continue;
+    fuse(fun);
+    for (Instr& in : fun.code)
+      in.handler = handlers ? handlers[in.op] : nullptr;
+  }
+  bound_handlers = handlers;
+  fused = fusing;
+}
+
+
+bool VM::fusable(uint8_t op)
+{
+  switch(op) {
+    case OP_NEW: case OP_NEW_LOCAL: case OP_SETFIELD_LOCAL:
+    case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP: case OP_FOR_PREP: case OP_FOR_LOOP: case OP_CALL: case OP_BUILTIN:
+    case OP_RETURN: case OP_ERROR:
+      return false;
+    default:
+      return true;
+  }
+}
+
+
+bool VM::ends_superinstruction(uint8_t op)
+{
+  return op == OP_JUMP or op == OP_JUMP_IF_FALSE;
+}
+
+
+void VM::sequence_counts(std::map<std::vector<uint8_t>,long>& counts,
+                         size_t max_length) const
+{
+  for (const LoadedFunction& fun : functions) {
+    for (size_t i = 0; i < fun.code.size(); ++i) {
+      if (fun.counts[i] == 0)
+        continue;
+      std::vector<uint8_t> seq(1, fun.code[i].base);
+      for (size_t j = i + 1; j < fun.code.size() and seq.size() < max_length; ++j) {
+        uint8_t prev = seq.back(), op = fun.code[j].base;
+        if (not fusable(prev) or ends_superinstruction(prev) or not fusable(op) or
+            fun.targets[j])
+          break;
+        seq.push_back(op);
+        counts[seq] += fun.counts[i];
+      }
+    }
+  }
+}
+
+
+Position VM::position(const Frame& frame, const Instr* ip)
+{
+  int offset = frame.fun->offsets[ip - frame.fun->code.data()];
+  return find_position(*frame.fun->source, offset);
+}
+
+
+void VM::error(const std::string& msg, const Frame& frame, const Instr* ip)
+{
+  Position p = position(frame, ip);
+  Runtime::error(msg, p.line, p.column);
+}
+
+
+// (references to the object stack's objects are skipped, their fields
+// are visited instead: every object area's, and those of the region
+// objects still referenced from the stack, an object area, or a region
+// object itself referenced, so a dead temporary in a region keeps
+// nothing on the heap alive)
+void VM::mark_roots(Heap& heap)
+{
+  std::vector<Object*> work;
+  std::unordered_set<Object*> reached;
+  auto visit = [&](Value& v) {
+    if (not v.is_object() or not local(v.as_object()))
+      heap.visit(v);
+    else if (reached.insert(v.as_object()).second)
+      work.push_back(v.as_object());
+  };
+  for (Value* v = stack; v != gc_top; ++v)
+    visit(*v);
+  for (const Frame& frame : frames) {
+    if (not frame.objects)
+      continue;
+    char* end = frame.objects + frame.fun->object_bytes;
+    for (char* p = frame.objects; p != end; ) {
+      Object* obj = reinterpret_cast<Object*>(p);
+      if (reached.insert(obj).second)
+        work.push_back(obj);
+      p += object_size(obj->field_count);
+    }
+  }
+  while (not work.empty()) {
+    Object* obj = work.back();
+    work.pop_back();
+    for (int i = 0; i < obj->field_count; ++i)
+      visit(obj->fields()[i]);
+  }
+  for (Value& v : escaping)
+    heap.visit(v);
+}
+
+
+// move the value stack to one with room for needed more values above
+// sp (rarely needed, so the frames' pointers are just rebased)
+void VM::grow(Value*& sp, size_t needed)
+{
+  size_t size = stack_end - stack;
+  size_t used = sp - stack;
+  size_t new_size = size + STACK_CHUNK * ((used + needed - size) / STACK_CHUNK + 1);
+  Value* new_stack = new Value[new_size];
+  for (size_t i = 0; i < used; ++i)
+    new_stack[i] = std::move(stack[i]);
+  for (Frame& frame : frames)
+    frame.locals = new_stack + (frame.locals - stack);
+  delete[] stack;
+  stack = new_stack;
+  stack_end = new_stack + new_size;
+  sp = new_stack + used;
+}
+
+
+// push a new frame whose first locals are the arguments on top of the
+// stack
+void VM::call(LoadedFunction& fun, Value*& sp, int argc)
+{
+  if (not fun.decoded)
+    decode(fun);
+  if (stack_end - sp < fun.frame_size)
+    grow(sp, fun.frame_size);
+  ++fun.hotness;
+  Frame frame = {&fun, fun.code.data(), sp - argc, nullptr, object_top};
+  if (fun.object_bytes)
+    push_objects(frame);
+  frames.push_back(frame);
+  sp = frame.locals + fun.source->local_count;
+}
+
+
+// reserve a frame's object area (if it fits) with its objects' headers
+// and nil fields
+void VM::push_objects(Frame& frame)
+{
+  const LoadedFunction& fun = *frame.fun;
+  if ((size_t)(object_stack + OBJECT_STACK - object_top) < (size_t)fun.object_bytes)
+    return;
+  frame.objects = object_top;
+  object_top += fun.object_bytes;
+  for (const LocalObject& o : fun.objects) {
+    Object* obj = reinterpret_cast<Object*>(frame.objects + o.offset);
+    obj->type_id = o.type_id;
+    obj->field_count = module.types[o.type_id].fields.size();
+    for (int i = 0; i < obj->field_count; ++i)
+      new (obj->fields() + i) Value();
+  }
+}
+
+
+// release the object stack from a frame's part on (the objects lie
+// one after another)
+void VM::pop_objects(const Frame& frame)
+{
+  for (char* p = frame.region; p != object_top; ) {
+    Object* obj = reinterpret_cast<Object*>(p);
+    for (int i = 0; i < obj->field_count; ++i)
+      obj->fields()[i].~Value();
+    p += object_size(obj->field_count);
+  }
+  object_top = frame.region;
+}
+
+
+// whether an object is on the object stack
+inline bool VM::local(const Object* obj) const
+{
+  const char* p = reinterpret_cast<const char*>(obj);
+  return p >= object_stack and p < object_top;
+}
+
+
+// the bytes an object takes on the object stack
+inline size_t VM::object_size(int field_count)
+{
+  static_assert(alignof(Value) <= 8, "objects are 8-byte aligned");
+  return (sizeof(Object) + field_count * sizeof(Value) + 7) & ~(size_t)7;
+}
+
+
+// a new object with nil fields in the frame's region (the top frame),
+// or null if it has no room or its function stopped using regions
+Object* VM::region_allocate(Frame& frame, int type_id)
+{
+  if (frame.fun->escaped_objects * ESCAPE_RATIO > frame.fun->region_objects)
+    return nullptr;
+  int field_count = module.types[type_id].fields.size();
+  size_t bytes = object_size(field_count);
+  if ((size_t)(object_top - frame.region) + bytes > FRAME_REGION or
+      (size_t)(object_stack + OBJECT_STACK - object_top) < bytes)
+    return nullptr;
+  Object* obj = reinterpret_cast<Object*>(object_top);
+  object_top += bytes;
+  obj->type_id = type_id;
+  obj->field_count = field_count;
+  for (int i = 0; i < field_count; ++i)
+    new (obj->fields() + i) Value();
+  ++frame.fun->region_objects;
+  ++region_count;
+  return obj;
+}
+
+
+// the frame whose part of the object stack holds an object
+const VM::Frame& VM::owner(const Object* obj) const
+{
+  const char* p = reinterpret_cast<const char*>(obj);
+  auto it = std::upper_bound(frames.begin(), frames.end(), p,
+                             [](const char* q, const Frame& f) {return q < f.region;});
+  return *(it - 1);
+}
+
+
+// whether an object on the object stack can be released before the
+// object holding it (the holder is on the heap or an older frame's)
+bool VM::outlives(const Object* holder, const Object* obj) const
+{
+  if (not local(holder))
+    return true;
+  const Frame* f = &owner(holder);
+  const char* end = f == &frames.back() ? object_top : (f + 1)->region;
+  return reinterpret_cast<const char*>(obj) >= end;
+}
+
+
+// store a value in a field of an object (on top of the stack), first
+// moving the value to the heap if it is a region object the object
+// would outlive (which can collect, so the object is read again)
+inline void VM::store(Object* obj, int i, Value& val, Value* sp)
+{
+  if (val.is_object() and local(val.as_object()) and outlives(obj, val.as_object())) {
+    escape(val, sp);
+    obj = sp[-1].as_object();
+  }
+  if (local(obj))
+    obj->fields()[i] = val;
+  else
+    rt.heap().store(obj, i, val);
+}
+
+
+// move a region object (on the stack below sp), and the region objects
+// it reaches, to the heap, and point every reference to them on the
+// stack and in the regions at the copies (the originals are left with
+// nil fields until their frames return)
+void VM::escape(Value& val, Value* sp)
+{
+  std::unordered_map<Object*,size_t> index;
+  std::vector<Object*> originals(1, val.as_object());
+  index[val.as_object()] = 0;
+  for (size_t k = 0; k < originals.size(); ++k) {
+    Object* obj = originals[k];
+    for (int i = 0; i < obj->field_count; ++i) {
+      const Value& v = obj->fields()[i];
+      if (v.is_object() and local(v.as_object()) and not index.count(v.as_object())) {
+        index[v.as_object()] = originals.size();
+        originals.push_back(v.as_object());
+      }
+    }
+  }
+  // (allocating can collect, which updates the copies)
+  gc_top = sp;
+  for (Object* obj : originals)
+    escaping.push_back(rt.new_object(obj->type_id));
+  auto moved = [&](Value& v) {
+    if (v.is_object() and local(v.as_object())) {
+      auto it = index.find(v.as_object());
+      if (it != index.end())
+        v = escaping[it->second];
+    }
+  };
+  for (size_t k = 0; k < originals.size(); ++k) {
+    Object* obj = originals[k];
+    Object* copy = escaping[k].as_object();
+    for (int i = 0; i < obj->field_count; ++i) {
+      Value& v = obj->fields()[i];
+      moved(v);
+      rt.heap().store(copy, i, v);
+      v = Value();
+    }
+    ++owner(obj).fun->escaped_objects;
+    ++escaped_count;
+  }
+  for (Value* v = stack; v != sp; ++v)
+    moved(*v);
+  for (char* p = object_stack; p != object_top; ) {
+    Object* obj = reinterpret_cast<Object*>(p);
+    for (int i = 0; i < obj->field_count; ++i)
+      moved(obj->fields()[i]);
+    p += object_size(obj->field_count);
+  }
+  escaping.clear();
+}
+
+
+// put a new object of a NEW or NEW_LOCAL instruction's type, with the
+// type's default field values, in the (nil) slot at sp: in the frame's
+// object area if the instruction has a place there, in its region in
+// region mode, otherwise on the heap
+inline void VM::allocate(Frame& frame, const Instr& in, Value* sp)
+{
+  const TypeDef& t = module.types[in.a];
+  Object* obj = nullptr;
+  if (in.b and frame.objects)
+    obj = reinterpret_cast<Object*>(frame.objects + 8 * in.cache_type);
+  else if (regions)
+    obj = region_allocate(frame, in.a);
+  if (obj) {
+    for (size_t i = 0; i < t.defaults.size(); ++i)
+      obj->fields()[i] = t.defaults[i];
+    *sp = Value::from_object(obj);
+  }
+  else {
+    gc_top = sp;
+    *sp = rt.new_object(in.a);
+    rt.heap().copy_fields(sp->as_object(), t.defaults);
+  }
+}
+
+
+// index in an object of the field an instruction names, from the
+// instruction's cache if it has the object's type (otherwise looked up
+// and cached); -1 if not a field
+inline int VM::cached_field(Object* obj, Instr& in)
+{
+  if (obj->type_id + 1 == in.cache_type)
+    return in.cache_slot;
+  int i = rt.field_index(obj->type_id, module.names[in.a]);
+  if (i >= 0 and i <= 0xFF and obj->type_id < 0xFFFF) {
+    in.cache_type = obj->type_id + 1;
+    in.cache_slot = i;
+  }
+  return i;
+}
+
+
+// as cached_field, but an error if not a field
+int VM::field(Object* obj, Instr& in, const Frame& frame)
+{
+  int i = cached_field(obj, in);
+  if (i < 0)
+    error("undefined field '" + module.names[in.a] + "'", frame, &in);
+  return i;
+}
+
+
+#if MYPL_JIT
+
+//----------------------------------------------------------------------
+// Baseline JIT
+//----------------------------------------------------------------------
+
+// Native code keeps the stack top (sp) in rbx, the frame's locals in
+// r12, the VM in r13, the constants in r14 and nil in r15, and works
+// on the value stack in memory, so the interpreter can continue it at
+// any instruction. Each instruction's code checks its operands' types
+// before changing anything, exiting at the instruction if they are
+// not the ones it handles; strings are retained and released, objects
+// allocated and fields stored by calling the helpers below.
+
+
+void VM::compile(LoadedFunction& fun)
+{
+  typedef Assembler::Label Label;
+  const uint64_t NIL = bits(Value());
+  const uint64_t INT = bits(Value::from_int(0));
+  const uint64_t BOOL = bits(Value::from_bool(false));
+  const int32_t INT_TAG = INT >> 48;
+  const int32_t BOOL_TAG = BOOL >> 48;
+  const int32_t STRING_TAG = bits(Value::from_string("")) >> 48;
+  const int32_t OBJECT_TAG = bits(Value::from_object(nullptr)) >> 48;
+  // (the top 13 bits of every boxed value, and of no double)
+  const int32_t BOXED = NIL >> 51;
+
+  Assembler a;
+  int n = fun.code.size();
+  std::vector<Label> starts(n), exits(n, -1);
+  for (Label& l : starts)
+    l = a.new_label();
+  Label error = a.new_label(), leave = a.new_label();
+  auto exit_at = [&](int i) {
+    if (exits[i] < 0)
+      exits[i] = a.new_label();
+    return exits[i];
+  };
+  // (checks use rcx)
+  auto if_tag = [&](Reg r, int32_t tag, Cond cc, Label l) {
+    a.mov(RCX, r);
+    a.shr(RCX, 48);
+    a.alu32(ALU_CMP, RCX, tag);
+    a.jcc(cc, l);
+  };
+  auto if_boxed = [&](Reg r, Cond cc, Label l) {
+    a.mov(RCX, r);
+    a.shr(RCX, 51);
+    a.alu32(ALU_CMP, RCX, BOXED);
+    a.jcc(cc, l);
+  };
+  auto call_helper = [&](uint64_t helper) {
+    a.mov(RAX, helper);
+    a.call(RAX);
+  };
+  auto call_instr = [&](uint64_t helper, Instr& in) {
+    a.mov(RDI, R13);
+    a.mov(RSI, (uint64_t)&in);
+    a.mov(RDX, RBX);
+    call_helper(helper);
+  };
+  auto pop = [&](int count) {
+    for (int k = 1; k <= count; ++k)
+      a.mov(RBX, -8 * k, R15);
+    a.alu(ALU_SUB, RBX, 8 * count);
+  };
+  auto push_copy = [&](Reg base, int32_t disp) {
+    Label copy = a.new_label(), done = a.new_label();
+    a.mov(RAX, base, disp);
+    if_tag(RAX, STRING_TAG, CC_E, copy);
+    a.mov(RBX, 0, RAX);
+    a.jmp(done);
+    a.bind(copy);
+    a.mov(RDI, RBX);
+    a.mov(RSI, base);
+    a.alu(ALU_ADD, RSI, disp);
+    call_helper((uint64_t)&native_copy);
+    a.bind(done);
+    a.alu(ALU_ADD, RBX, 8);
+  };
+  auto release = [&](Reg base, int32_t disp) {
+    Label done = a.new_label();
+    a.mov(RAX, base, disp);
+    if_tag(RAX, STRING_TAG, CC_NE, done);
+    a.mov(RDI, base);
+    a.alu(ALU_ADD, RDI, disp);
+    call_helper((uint64_t)&native_release);
+    a.bind(done);
+  };
+
+  // entry: save the registers the code uses (keeping the stack 16-byte
+  // aligned for calls) and jump to the instruction's code
+  a.push(RBP);
+  a.mov(RBP, RSP);
+  for (Reg r : {RBX, R12, R13, R14, R15})
+    a.push(r);
+  a.alu(ALU_SUB, RSP, 8);
+  a.mov(R13, RDI);
+  a.mov(RBX, RSI);
+  a.mov(R12, RDX);
+  a.mov(R14, RCX);
+  a.mov(R15, NIL);
+  a.jmp(R8);
+
+  for (int i = 0; i < n; ++i) {
+    Instr& in = fun.code[i];
+    a.bind(starts[i]);
+    switch(in.base) {
+      case OP_NIL: case OP_TRUE: case OP_FALSE:
+        a.mov(RAX, in.base == OP_NIL ? NIL : BOOL | (in.base == OP_TRUE));
+        a.mov(RBX, 0, RAX);
+        a.alu(ALU_ADD, RBX, 8);
+        break;
+      case OP_CONST:
+        push_copy(R14, 8 * in.a);
+        break;
+      case OP_LOAD:
+        push_copy(R12, 8 * in.a);
+        break;
+      case OP_DUP:
+        push_copy(RBX, -8);
+        break;
+      case OP_STORE:
+        release(R12, 8 * in.a);
+        a.mov(RAX, RBX, -8);
+        a.mov(R12, 8 * in.a, RAX);
+        pop(1);
+        break;
+      case OP_POP:
+        release(RBX, -8);
+        pop(1);
+        break;
+      case OP_NEW: case OP_NEW_LOCAL:
+        // (an object passed to an init function is left to the
+        // interpreter, which calls it)
+        if (module.types[in.a].init_function >= 0) {
+          a.jmp(exit_at(i));
+          break;
+        }
+        call_instr((uint64_t)&native_new, in);
+        a.alu(ALU_CMP, RAX, 0);
+        a.jcc(CC_L, error);
+        a.alu(ALU_ADD, RBX, 8);
+        break;
+      case OP_GETFIELD: {
+        // a field holding a string, or one of another type than the
+        // cached one, is read by the helper
+        Label slow = a.new_label(), done = a.new_label();
+        a.mov(RAX, RBX, -8);
+        if_tag(RAX, OBJECT_TAG, CC_NE, slow);
+        a.shl(RAX, 16);
+        a.shr(RAX, 16);
+        a.mov32(RCX, RAX, offsetof(Object, type_id));
+        a.alu32(ALU_ADD, RCX, 1);
+        a.mov(RDX, (uint64_t)&in);
+        a.movzx16(RSI, RDX, offsetof(Instr, cache_type));
+        a.alu32(ALU_CMP, RCX, RSI);
+        a.jcc(CC_NE, slow);
+        a.movzx8(RSI, RDX, offsetof(Instr, cache_slot));
+        a.shl(RSI, 3);
+        a.alu(ALU_ADD, RAX, RSI);
+        a.mov(RAX, RAX, sizeof(Object));
+        if_tag(RAX, STRING_TAG, CC_E, slow);
+        a.mov(RBX, -8, RAX);
+        a.jmp(done);
+        a.bind(slow);
+        call_instr((uint64_t)&native_getfield, in);
+        a.alu(ALU_CMP, RAX, 0);
+        a.jcc(CC_E, exit_at(i));
+        a.bind(done);
+        break;
+      }
+      case OP_SETFIELD: case OP_SETFIELD_LOCAL:
+        call_instr((uint64_t)&native_setfield, in);
+        a.alu(ALU_CMP, RAX, 0);
+        a.jcc(CC_E, exit_at(i));
+        a.jcc(CC_L, error);
+        a.alu(ALU_SUB, RBX, 16);
+        break;
+      case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+      case OP_LT: case OP_LE: case OP_GT: case OP_GE: {
+        // ints (division by 0 and -1 left to the interpreter), then
+        // doubles (as the interpreter compares them, and NaN results
+        // left to it)
+        bool compare = in.base >= OP_LT;
+        Label doubles = a.new_label(), done = a.new_label();
+        a.mov(RAX, RBX, -16);
+        a.mov(RSI, RBX, -8);
+        if_tag(RAX, INT_TAG, CC_NE, doubles);
+        if_tag(RSI, INT_TAG, CC_NE, doubles);
+        switch(in.base) {
+          case OP_ADD: a.alu32(ALU_ADD, RAX, RSI); break;
+          case OP_SUB: a.alu32(ALU_SUB, RAX, RSI); break;
+          case OP_MUL: a.imul32(RAX, RSI); break;
+          case OP_DIV: case OP_MOD:
+            a.alu32(ALU_CMP, RSI, 0);
+            a.jcc(CC_E, exit_at(i));
+            a.alu32(ALU_CMP, RSI, -1);
+            a.jcc(CC_E, exit_at(i));
+            a.cdq();
+            a.idiv32(RSI);
+            if (in.base == OP_MOD)
+              a.mov(RAX, RDX);
+            break;
+          default:
+            a.alu32(ALU_CMP, RAX, RSI);
+            a.setcc(in.base == OP_LT ? CC_L : in.base == OP_LE ? CC_LE :
+                    in.base == OP_GT ? CC_G : CC_GE, RAX);
+        }
+        a.mov(RCX, compare ? BOOL : INT);
+        a.alu(ALU_OR, RAX, RCX);
+        a.jmp(done);
+        a.bind(doubles);
+        if (in.base == OP_MOD)
+          a.jmp(exit_at(i));
+        else {
+          if_boxed(RAX, CC_E, exit_at(i));
+          if_boxed(RSI, CC_E, exit_at(i));
+          a.movq(XMM0, RAX);
+          a.movq(XMM1, RSI);
+          switch(in.base) {
+            case OP_ADD: a.addsd(XMM0, XMM1); break;
+            case OP_SUB: a.subsd(XMM0, XMM1); break;
+            case OP_MUL: a.mulsd(XMM0, XMM1); break;
+            case OP_DIV: a.divsd(XMM0, XMM1); break;
+            case OP_LT: a.ucomisd(XMM1, XMM0); a.setcc(CC_A, RAX); break;
+            case OP_LE: a.ucomisd(XMM0, XMM1); a.setcc(CC_BE, RAX); break;
+            case OP_GT: a.ucomisd(XMM0, XMM1); a.setcc(CC_A, RAX); break;
+            default: a.ucomisd(XMM1, XMM0); a.setcc(CC_BE, RAX);
+          }
+          if (compare) {
+            a.mov(RCX, BOOL);
+            a.alu(ALU_OR, RAX, RCX);
+          }
+          else {
+            a.ucomisd(XMM0, XMM0);
+            a.jcc(CC_P, exit_at(i));
+            a.movq(RAX, XMM0);
+          }
+        }
+        a.bind(done);
+        a.mov(RBX, -16, RAX);
+        pop(1);
+        break;
+      }
+      case OP_EQ: case OP_NE: {
+        // boxed values other than strings are equal if their bits are
+        Label doubles = a.new_label(), done = a.new_label();
+        a.mov(RAX, RBX, -16);
+        a.mov(RSI, RBX, -8);
+        if_boxed(RAX, CC_NE, doubles);
+        if_boxed(RSI, CC_NE, exit_at(i));
+        if_tag(RAX, STRING_TAG, CC_E, exit_at(i));
+        if_tag(RSI, STRING_TAG, CC_E, exit_at(i));
+        a.alu(ALU_CMP, RAX, RSI);
+        a.setcc(in.base == OP_EQ ? CC_E : CC_NE, RAX);
+        a.jmp(done);
+        a.bind(doubles);
+        if_boxed(RSI, CC_E, exit_at(i));
+        a.movq(XMM0, RAX);
+        a.movq(XMM1, RSI);
+        a.ucomisd(XMM0, XMM1);
+        a.setcc(CC_E, RAX);
+        a.setcc(CC_NP, RCX);
+        a.alu32(ALU_AND, RAX, RCX);
+        if (in.base == OP_NE)
+          a.alu32(ALU_XOR, RAX, 1);
+        a.bind(done);
+        a.mov(RCX, BOOL);
+        a.alu(ALU_OR, RAX, RCX);
+        a.mov(RBX, -16, RAX);
+        pop(1);
+        break;
+      }
+      case OP_NOT:
+        a.mov(RAX, RBX, -8);
+        if_tag(RAX, BOOL_TAG, CC_NE, exit_at(i));
+        a.alu(ALU_XOR, RAX, 1);
+        a.mov(RBX, -8, RAX);
+        break;
+      case OP_NEG:
+        a.mov(RAX, RBX, -8);
+        if_tag(RAX, INT_TAG, CC_NE, exit_at(i));
+        a.neg32(RAX);
+        a.mov(RCX, INT);
+        a.alu(ALU_OR, RAX, RCX);
+        a.mov(RBX, -8, RAX);
+        break;
+      case OP_JUMP:
+        a.jmp(starts[in.a]);
+        break;
+      case OP_JUMP_IF_FALSE:
+        a.mov(RAX, RBX, -8);
+        if_tag(RAX, BOOL_TAG, CC_NE, exit_at(i));
+        pop(1);
+        a.alu32(ALU_AND, RAX, 1);
+        a.jcc(CC_E, starts[in.a]);
+        break;
+      case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+        a.mov(RAX, RBX, -8);
+        if_tag(RAX, BOOL_TAG, CC_NE, exit_at(i));
+        a.alu32(ALU_AND, RAX, 1);
+        a.jcc(in.base == OP_JUMP_IF_FALSE_OR_POP ? CC_E : CC_NE, starts[in.a]);
+        pop(1);
+        break;
+      case OP_FOR_PREP:
+        a.mov(RAX, RBX, -16);
+        a.mov(RSI, RBX, -8);
+        if_tag(RAX, INT_TAG, CC_NE, exit_at(i));
+        if_tag(RSI, INT_TAG, CC_NE, exit_at(i));
+        release(R12, 8 * in.b);
+        release(R12, 8 * in.b + 8);
+        a.mov(RAX, RBX, -16);
+        a.mov(RSI, RBX, -8);
+        a.mov(R12, 8 * in.b, RAX);
+        a.mov(R12, 8 * in.b + 8, RSI);
+        pop(2);
+        a.alu32(ALU_CMP, RAX, RSI);
+        a.jcc(CC_G, starts[in.a]);
+        break;
+      case OP_FOR_LOOP: {
+        Label done = a.new_label();
+        a.mov(RAX, R12, 8 * in.b);
+        a.mov(RSI, R12, 8 * in.b + 8);
+        a.alu32(ALU_CMP, RAX, RSI);
+        a.jcc(CC_GE, done);
+        a.alu32(ALU_ADD, RAX, 1);
+        a.mov(RCX, INT);
+        a.alu(ALU_OR, RAX, RCX);
+        a.mov(R12, 8 * in.b, RAX);
+        a.jmp(starts[in.a]);
+        a.bind(done);
+        break;
+      }
+      case OP_BUILTIN:
+        call_instr((uint64_t)&native_builtin, in);
+        a.alu(ALU_CMP, RAX, 0);
+        a.jcc(CC_L, error);
+        a.alu(ALU_ADD, RBX, 8 - 8 * in.b);
+        break;
+      default:
+        // (calls, returns and errors)
+        a.jmp(exit_at(i));
+    }
+  }
+
+  for (int i = 0; i < n; ++i) {
+    if (exits[i] >= 0) {
+      a.bind(exits[i]);
+      a.mov(RDX, (uint64_t)i);
+      a.jmp(leave);
+    }
+  }
+  a.bind(error);
+  a.mov(RDX, (uint64_t)-1);
+  a.bind(leave);
+  a.mov(RAX, RBX);
+  a.alu(ALU_ADD, RSP, 8);
+  for (Reg r : {R15, R14, R13, R12, RBX, RBP})
+    a.pop(r);
+  a.ret();
+  a.resolve();
+
+  fun.native.reset(new ExecutableCode(a.code));
+  for (int i = 0; i < n; ++i)
+    fun.entries.push_back(fun.native->start() + a.offset(starts[i]));
+  ++compiled_count;
+}
+
+
+// run a function's native code (compiling it first) from the
+// instruction at ip until it exits, returning the instruction the
+// interpreter continues at
+VM::Instr* VM::run_native(Frame& frame, Instr* ip, Value*& sp)
+{
+  LoadedFunction& fun = *frame.fun;
+  if (not fun.native)
+    compile(fun);
+  typedef NativeExit (*Code)(VM*, Value*, Value*, const Value*, const uint8_t*);
+  Code code = fun.native->function<Code>();
+  NativeExit result = code(this, sp, frame.locals, constants, fun.entries[ip - fun.code.data()]);
+  sp = result.sp;
+  if (result.index < 0) {
+    std::exception_ptr e = pending;
+    pending = nullptr;
+    std::rethrow_exception(e);
+  }
+  return fun.code.data() + result.index;
+}
+
+
+uint64_t VM::bits(const Value& v)
+{
+  uint64_t b;
+  std::memcpy(&b, static_cast<const void*>(&v), 8);
+  return b;
+}
+
+
+// Helpers called from native code (which cannot be unwound through, so
+// the ones that can throw catch the exception, keep it in pending and
+// return -1; 0 exits to the interpreter at the instruction, as for an
+// operand the helper does not handle, and 1 continues).
+
+// copy a value to a nil slot
+void VM::native_copy(Value* dst, const Value* src)
+{
+  *dst = *src;
+}
+
+
+// release a value, leaving the slot nil
+void VM::native_release(Value* v)
+{
+  *v = Value();
+}
+
+
+long VM::native_getfield(VM* vm, Instr* in, Value* sp)
+{
+  if (not sp[-1].is_object())
+    return 0;
+  Object* obj = sp[-1].as_object();
+  int f = vm->cached_field(obj, *in);
+  if (f < 0)
+    return 0;
+  sp[-1] = obj->fields()[f];
+  return 1;
+}
+
+
+long VM::native_setfield(VM* vm, Instr* in, Value* sp)
+{
+  if (not sp[-1].is_object())
+    return 0;
+  Object* obj = sp[-1].as_object();
+  int f = vm->cached_field(obj, *in);
+  if (f < 0)
+    return 0;
+  try {
+    if (in->base == OP_SETFIELD_LOCAL and vm->local(obj))
+      obj->fields()[f] = sp[-2];
+    else
+      vm->store(obj, f, sp[-2], sp);
+  }
+  catch (...) {
+    vm->pending = std::current_exception();
+    return -1;
+  }
+  sp[-1] = Value();
+  sp[-2] = Value();
+  return 1;
+}
+
+
+long VM::native_new(VM* vm, Instr* in, Value* sp)
+{
+  try {
+    vm->allocate(vm->frames.back(), *in, sp);
+  }
+  catch (...) {
+    vm->pending = std::current_exception();
+    return -1;
+  }
+  return 1;
+}
+
+
+long VM::native_builtin(VM* vm, Instr* in, Value* sp)
+{
+  int argc = in->b;
+  try {
+    Position p = vm->position(vm->frames.back(), in);
+    Value result = vm->rt.call_builtin(in->a, sp - argc, argc, p.line, p.column);
+    for (int i = 0; i < argc; ++i)
+      *--sp = Value();
+    *sp = std::move(result);
+  }
+  catch (...) {
+    vm->pending = std::current_exception();
+    return -1;
+  }
+  return 1;
+}
+
+#endif
+
+
+//----------------------------------------------------------------------
+// Interpreter Loop
+//----------------------------------------------------------------------
+
+
+void VM::run()
+{
+  // (a run ended by an error leaves its frames' values on the stack,
+  // and their objects)
+  if (not frames.empty()) {
+    for (Value* v = stack; v != stack_end; ++v)
+      *v = Value();
+    pop_objects(frames.front());
+    frames.clear();
+  }
+  instruction_count = 0;
+  if (counting)
+    execute<true>();
+  else
+    execute<false>();
+}
+
+
+// Handlers are written once for both dispatch modes: TARGET labels a
+// handler and DISPATCH continues with the instruction at ip. With
+// threading the switch is only used to enter the first instruction,
+// and since a computed goto does not run destructors, handlers must
+// not DISPATCH with non-trivial locals in scope.
+#define COUNT()                                                 \
+  if (Count) {                                                  \
+    ++instruction_count;                                        \
+    ++frame->fun->counts[ip - frame->fun->code.data()];         \
+  }
+#if MYPL_THREADED
+#define TARGET(op) case op: L_##op
+#define SUPER_TARGET(n) case OP_COUNT + n: L_SUPER_##n
+#define DISPATCH()                              \
+  do {                                          \
+    COUNT();                                    \
+    goto *ip->handler;                          \
+  } while (0)
+#define HANDLER(op) handlers[op]
+#define REDISPATCH() goto *ip->handler
+#else
+#define TARGET(op) case op
+#define SUPER_TARGET(n) case OP_COUNT + n
+#define DISPATCH() continue
+#define HANDLER(op) nullptr
+#define REDISPATCH() {op = ip->op; goto dispatch;}
+#endif
+
+// the value stack above the frame's locals (sp is one past the top,
+// and popped values are released)
+#define PUSH(v) (*sp++ = (v))
+#define POP() (*--sp = Value())
+#define TOP() sp[-1]
+
+// in JIT mode, continue in the frame's native code once its function
+// is hot, and count a jump back from the instruction at from toward it
+// being hot
+#if MYPL_JIT
+#define NATIVE()                                                        \
+  if (jit and frame->fun->hotness >= JIT_THRESHOLD)                     \
+    ip = run_native(*frame, ip, sp);
+#else
+#define NATIVE()
+#endif
+#define BACK_EDGE(from)                                                 \
+  if (jit and ip <= (from)) {                                           \
+    ++frame->fun->hotness;                                              \
+    NATIVE();                                                           \
+  }
+
+// integer fast path of a binary operator on the top two stack values
+// (i and j, or x and y as unsigned for wrapping arithmetic), otherwise
+// the runtime's generic operator
+#define INT_BINARY(valid, result)                                       \
+  {                                                                     \
+    Value& lhs = sp[-2];                                                \
+    const Value& rhs = sp[-1];                                          \
+    if (lhs.is_int() and rhs.is_int()) {                                \
+      int i = lhs.as_int(), j = rhs.as_int();                           \
+      unsigned x = i, y = j;                                            \
+      (void)x; (void)y;                                                 \
+      if (valid) {                                                      \
+        lhs = result;                                                   \
+        POP();                                                          \
+        ++ip;                                                           \
+        DISPATCH();                                                     \
+      }                                                                 \
+    }                                                                   \
+    goto generic_binary;                                                \
+  }
+
+
+// rewrite a generic instruction (unless fused or left generic) into
+// the quickened form for its operands' types (-1 if none) and run that
+#define QUICKEN(int_op, double_op, string_op)                           \
+  if (ip->op == ip->base and not ip->b) {                               \
+    const Value& lhs = sp[-2];                                          \
+    const Value& rhs = sp[-1];                                          \
+    int q = -1;                                                         \
+    if (lhs.is_int() and rhs.is_int())                                  \
+      q = int_op;                                                       \
+    else if (lhs.is_double() and rhs.is_double())                       \
+      q = double_op;                                                    \
+    else if (lhs.is_string() and rhs.is_string())                       \
+      q = string_op;                                                    \
+    if (q >= 0) {                                                       \
+      ip->op = q;                                                       \
+      ip->handler = HANDLER(q);                                         \
+      REDISPATCH();                                                     \
+    }                                                                   \
+  }
+
+// a quickened instruction whose guard fails goes back to (and stays)
+// generic
+#define DEQUICKEN()                                                     \
+  {                                                                     \
+    ip->op = ip->base;                                                  \
+    ip->b = 1;                                                          \
+    ip->handler = HANDLER(ip->base);                                    \
+    goto generic_binary;                                                \
+  }
+
+#define QUICK_INT(valid, result)                                        \
+  {                                                                     \
+    Value& lhs = sp[-2];                                                \
+    const Value& rhs = sp[-1];                                          \
+    if (not lhs.is_int() or not rhs.is_int())                           \
+      DEQUICKEN();                                                      \
+    int i = lhs.as_int(), j = rhs.as_int();                             \
+    unsigned x = i, y = j;                                              \
+    (void)x; (void)y;                                                   \
+    if (not (valid))                                                    \
+      goto generic_binary;                                              \
+    lhs = result;                                                       \
+    POP();                                                              \
+    ++ip;                                                               \
+    DISPATCH();                                                         \
+  }
+#define QUICK_DOUBLE(result)                                            \
+  {                                                                     \
+    Value& lhs = sp[-2];                                                \
+    const Value& rhs = sp[-1];                                          \
+    if (not lhs.is_double() or not rhs.is_double())                     \
+      DEQUICKEN();                                                      \
+    double x = lhs.as_double(), y = rhs.as_double();                    \
+    lhs = result;                                                       \
+    POP();                                                              \
+    ++ip;                                                               \
+    DISPATCH();                                                         \
+  }
+#define QUICK_STRING_EQ(equal)                                          \
+  {                                                                     \
+    if (not sp[-2].is_string() or not sp[-1].is_string())               \
+      DEQUICKEN();                                                      \
+    bool same = Value::string_equal(sp[-2], sp[-1]);                    \
+    POP();                                                              \
+    TOP() = Value::from_bool(same == equal);                            \
+    ++ip;                                                               \
+    DISPATCH();                                                         \
+  }
+
+
+// Superinstruction handlers (generated in superinstructions.h) are
+// sequences of the BODY macros below, each running the k-th fused
+// instruction (at ip[k]). A body that cannot take its fast path falls
+// back to the unfused handlers from its instruction on.
+#if MYPL_THREADED
+#define SUPER_FALLBACK(k) {ip += k; COUNT(); goto *handlers[ip->base];}
+#else
+#define SUPER_FALLBACK(k) {ip += k; COUNT(); op = ip->base; goto dispatch;}
+#endif
+#define SUPER_NEXT(n) ip += n; DISPATCH();
+#define BODY_NIL(k) PUSH(Value());
+#define BODY_TRUE(k) PUSH(Value::from_bool(true));
+#define BODY_FALSE(k) PUSH(Value::from_bool(false));
+#define BODY_CONST(k) PUSH(constants[ip[k].a]);
+#define BODY_LOAD(k) PUSH(frame->locals[ip[k].a]);
+#define BODY_STORE(k) frame->locals[ip[k].a] = std::move(TOP()); POP();
+#define BODY_POP(k) POP();
+#define BODY_DUP(k) sp[0] = sp[-1]; ++sp;
+#define BODY_GETFIELD(k)                                                \
+  {                                                                     \
+    if (not TOP().is_object())                                          \
+      SUPER_FALLBACK(k);                                                \
+    Object* obj = TOP().as_object();                                    \
+    int f = cached_field(obj, ip[k]);                                   \
+    if (f < 0)                                                          \
+      SUPER_FALLBACK(k);                                                \
+    TOP() = obj->fields()[f];                                           \
+  }
+#define BODY_SETFIELD(k)                                                \
+  {                                                                     \
+    if (not TOP().is_object())                                          \
+      SUPER_FALLBACK(k);                                                \
+    Object* obj = TOP().as_object();                                    \
+    int f = cached_field(obj, ip[k]);                                   \
+    if (f < 0)                                                          \
+      SUPER_FALLBACK(k);                                                \
+    store(obj, f, sp[-2], sp);                                          \
+    POP();                                                              \
+    POP();                                                              \
+  }
+#define BODY_INT_BINARY(k, valid, result)                               \
+  {                                                                     \
+    Value& lhs = sp[-2];                                                \
+    const Value& rhs = sp[-1];                                          \
+    if (not lhs.is_int() or not rhs.is_int())                           \
+      SUPER_FALLBACK(k);                                                \
+    int i = lhs.as_int(), j = rhs.as_int();                             \
+    unsigned x = i, y = j;                                              \
+    (void)x; (void)y;                                                   \
+    if (not (valid))                                                    \
+      SUPER_FALLBACK(k);                                                \
+    lhs = result;                                                       \
+    POP();                                                              \
+  }
+#define BODY_ADD(k) BODY_INT_BINARY(k, true, Value::from_int(x + y))
+#define BODY_SUB(k) BODY_INT_BINARY(k, true, Value::from_int(x - y))
+#define BODY_MUL(k) BODY_INT_BINARY(k, true, Value::from_int(x * y))
+#define BODY_DIV(k) BODY_INT_BINARY(k, j != 0 and j != -1, Value::from_int(i / j))
+#define BODY_MOD(k) BODY_INT_BINARY(k, j != 0 and j != -1, Value::from_int(i % j))
+#define BODY_EQ(k) BODY_INT_BINARY(k, true, Value::from_bool(i == j))
+#define BODY_NE(k) BODY_INT_BINARY(k, true, Value::from_bool(i != j))
+#define BODY_LT(k) BODY_INT_BINARY(k, true, Value::from_bool(i < j))
+#define BODY_LE(k) BODY_INT_BINARY(k, true, Value::from_bool(i <= j))
+#define BODY_GT(k) BODY_INT_BINARY(k, true, Value::from_bool(i > j))
+#define BODY_GE(k) BODY_INT_BINARY(k, true, Value::from_bool(i >= j))
+#define BODY_NOT(k)                                                     \
+  if (not TOP().is_bool())                                              \
+    SUPER_FALLBACK(k);                                                  \
+  TOP() = Value::from_bool(not TOP().as_bool());
+#define BODY_NEG(k)                                                     \
+  if (TOP().is_int())                                                   \
+    TOP() = Value::from_int(0u - TOP().as_int());                       \
+  else                                                                  \
+    SUPER_FALLBACK(k);
+#define BODY_JUMP(k)                                                    \
+  {                                                                     \
+    Instr* from = ip + k;                                               \
+    ip = frame->fun->code.data() + ip[k].a;                             \
+    BACK_EDGE(from);                                                    \
+    DISPATCH();                                                         \
+  }
+#define BODY_JUMP_IF_FALSE(k)                                           \
+  {                                                                     \
+    if (not TOP().is_bool())                                            \
+      SUPER_FALLBACK(k);                                                \
+    bool taken = not TOP().as_bool();                                   \
+    POP();                                                              \
+    ip = taken ? frame->fun->code.data() + ip[k].a : ip + k + 1;        \
+    DISPATCH();                                                         \
+  }
+
+
+template<bool Count>
+void VM::execute()
+{
+#if MYPL_THREADED
+  static const void* const handlers[QUICK_END] = {
+    &&L_OP_NIL, &&L_OP_TRUE, &&L_OP_FALSE, &&L_OP_CONST, &&L_OP_LOAD,
+    &&L_OP_STORE, &&L_OP_POP, &&L_OP_DUP, &&L_OP_NEW, &&L_OP_GETFIELD,
+    &&L_OP_SETFIELD, &&L_OP_NEW_LOCAL, &&L_OP_SETFIELD_LOCAL, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV,
+    &&L_OP_MOD, &&L_OP_EQ, &&L_OP_NE, &&L_OP_LT, &&L_OP_LE, &&L_OP_GT,
+    &&L_OP_GE, &&L_OP_NOT, &&L_OP_NEG, &&L_OP_JUMP, &&L_OP_JUMP_IF_FALSE,
+    &&L_OP_JUMP_IF_FALSE_OR_POP, &&L_OP_JUMP_IF_TRUE_OR_POP,
+    &&L_OP_FOR_PREP, &&L_OP_FOR_LOOP, &&L_OP_CALL, &&L_OP_BUILTIN, &&L_OP_RETURN,
+    &&L_OP_ERROR,
+    SUPERINSTRUCTION_LABELS,
+    &&L_Q_ADD_INT, &&L_Q_SUB_INT, &&L_Q_MUL_INT, &&L_Q_DIV_INT, &&L_Q_MOD_INT,
+    &&L_Q_EQ_INT, &&L_Q_NE_INT, &&L_Q_LT_INT, &&L_Q_LE_INT, &&L_Q_GT_INT,
+    &&L_Q_GE_INT, &&L_Q_ADD_DOUBLE, &&L_Q_SUB_DOUBLE, &&L_Q_MUL_DOUBLE,
+    &&L_Q_DIV_DOUBLE, &&L_Q_EQ_DOUBLE, &&L_Q_NE_DOUBLE, &&L_Q_LT_DOUBLE,
+    &&L_Q_LE_DOUBLE, &&L_Q_GT_DOUBLE, &&L_Q_GE_DOUBLE, &&L_Q_EQ_STRING,
+    &&L_Q_NE_STRING
+  };
+  bind(handlers);
+#else
+  bind(nullptr);
+#endif
+  static const TokenType ops[] = {PLUS, MINUS, MULTIPLY, DIVIDE, MODULO, EQUAL,
+                                  NOT_EQUAL, LESS, LESS_EQUAL, GREATER,
+                                  GREATER_EQUAL};
+
+  // (the last main declared, as for calls)
+  size_t main = functions.size();
+  while (main > 0 and module.functions[main - 1].name != "main")
+    --main;
+  if (main == 0)
+    throw MyPLException(RUNTIME, "undefined 'main' function", 0, 0);
+  frames.clear();
+  Value* sp = stack;
+  call(functions[main - 1], sp, 0);
+  size_t exit_depth = 0;
+  const bool jit = MYPL_JIT and jitting and not Count;
+
+  Frame* frame = &frames.back();
+  Instr* ip = frame->ip;
+  uint8_t op;
+  while (true) {
+    COUNT();
+    op = ip->op;
+#if not MYPL_THREADED
+  dispatch:
+#endif
+    switch(op) {
+      TARGET(OP_NIL):
+        PUSH(Value());
+        ++ip;
+        DISPATCH();
+      TARGET(OP_TRUE):
+        PUSH(Value::from_bool(true));
+        ++ip;
+        DISPATCH();
+      TARGET(OP_FALSE):
+        PUSH(Value::from_bool(false));
+        ++ip;
+        DISPATCH();
+      TARGET(OP_CONST):
+        PUSH(constants[ip->a]);
+        ++ip;
+        DISPATCH();
+      TARGET(OP_LOAD):
+        PUSH(frame->locals[ip->a]);
+        ++ip;
+        DISPATCH();
+      TARGET(OP_STORE):
+        frame->locals[ip->a] = std::move(TOP());
+        POP();
+        ++ip;
+        DISPATCH();
+      TARGET(OP_POP):
+        POP();
+        ++ip;
+        DISPATCH();
+      TARGET(OP_DUP):
+        sp[0] = sp[-1];
+        ++sp;
+        ++ip;
+        DISPATCH();
+      TARGET(OP_NEW_LOCAL):
+      TARGET(OP_NEW): {
+        const TypeDef& t = module.types[ip->a];
+        allocate(*frame, *ip, sp);
+        ++sp;
+        ++ip;
+        if (t.init_function >= 0) {
+          frame->ip = ip;
+          call(functions[t.init_function], sp, 1);
+          frame = &frames.back();
+          ip = frame->ip;
+        }
+        DISPATCH();
+      }
+      TARGET(OP_GETFIELD): {
+        Position p = {0, 0, 0};
+        if (not TOP().is_object())
+          p = position(*frame, ip);
+        Object* obj = rt.deref(TOP(), module.names[ip->a], p.line, p.column);
+        TOP() = obj->fields()[field(obj, *ip, *frame)];
+        ++ip;
+        DISPATCH();
+      }
+      TARGET(OP_SETFIELD): {
+        Position p = {0, 0, 0};
+        if (not TOP().is_object())
+          p = position(*frame, ip);
+        Object* obj = rt.deref(TOP(), module.names[ip->a], p.line, p.column);
+        store(obj, field(obj, *ip, *frame), sp[-2], sp);
+        POP();
+        POP();
+        ++ip;
+        DISPATCH();
+      }
+      TARGET(OP_SETFIELD_LOCAL): {
+        // (the frame's own object takes no write barrier, nor can it
+        // outlive a region object the frame has)
+        Position p = {0, 0, 0};
+        if (not TOP().is_object())
+          p = position(*frame, ip);
+        Object* obj = rt.deref(TOP(), module.names[ip->a], p.line, p.column);
+        int f = field(obj, *ip, *frame);
+        if (local(obj))
+          obj->fields()[f] = sp[-2];
+        else
+          store(obj, f, sp[-2], sp);
+        POP();
+        POP();
+        ++ip;
+        DISPATCH();
+      }
+      TARGET(OP_ADD):
+        QUICKEN(Q_ADD_INT, Q_ADD_DOUBLE, -1)
+        INT_BINARY(true, Value::from_int(x + y))
+      TARGET(OP_SUB):
+        QUICKEN(Q_SUB_INT, Q_SUB_DOUBLE, -1)
+        INT_BINARY(true, Value::from_int(x - y))
+      TARGET(OP_MUL):
+        QUICKEN(Q_MUL_INT, Q_MUL_DOUBLE, -1)
+        INT_BINARY(true, Value::from_int(x * y))
+      TARGET(OP_DIV):
+        QUICKEN(Q_DIV_INT, Q_DIV_DOUBLE, -1)
+        INT_BINARY(j != 0 and j != -1, Value::from_int(i / j))
+      TARGET(OP_MOD):
+        QUICKEN(Q_MOD_INT, -1, -1)
+        INT_BINARY(j != 0 and j != -1, Value::from_int(i % j))
+      TARGET(OP_EQ):
+        QUICKEN(Q_EQ_INT, Q_EQ_DOUBLE, Q_EQ_STRING)
+        INT_BINARY(true, Value::from_bool(i == j))
+      TARGET(OP_NE):
+        QUICKEN(Q_NE_INT, Q_NE_DOUBLE, Q_NE_STRING)
+        INT_BINARY(true, Value::from_bool(i != j))
+      TARGET(OP_LT):
+        QUICKEN(Q_LT_INT, Q_LT_DOUBLE, -1)
+        INT_BINARY(true, Value::from_bool(i < j))
+      TARGET(OP_LE):
+        QUICKEN(Q_LE_INT, Q_LE_DOUBLE, -1)
+        INT_BINARY(true, Value::from_bool(i <= j))
+      TARGET(OP_GT):
+        QUICKEN(Q_GT_INT, Q_GT_DOUBLE, -1)
+        INT_BINARY(true, Value::from_bool(i > j))
+      TARGET(OP_GE):
+        QUICKEN(Q_GE_INT, Q_GE_DOUBLE, -1)
+        INT_BINARY(true, Value::from_bool(i >= j))
+      TARGET(OP_NOT):
+        if (not TOP().is_bool())
+          Runtime::error("expecting boolean operand for 'not'", 0, 0);
+        TOP() = Value::from_bool(not TOP().as_bool());
+        ++ip;
+        DISPATCH();
+      TARGET(OP_NEG):
+        TOP() = rt.negate(TOP(), 0, 0);
+        ++ip;
+        DISPATCH();
+      TARGET(OP_JUMP): {
+        Instr* from = ip;
+        ip = frame->fun->code.data() + ip->a;
+        BACK_EDGE(from);
+        DISPATCH();
+      }
+      TARGET(OP_JUMP_IF_FALSE):
+        if (not TOP().is_bool())
+          error("expecting boolean condition", *frame, ip);
+        if (TOP().as_bool())
+          ++ip;
+        else
+          ip = frame->fun->code.data() + ip->a;
+        POP();
+        DISPATCH();
+      TARGET(OP_JUMP_IF_FALSE_OR_POP):
+      TARGET(OP_JUMP_IF_TRUE_OR_POP): {
+        if (not TOP().is_bool()) {
+          std::string name = ip->base == OP_JUMP_IF_FALSE_OR_POP ? "and" : "or";
+          error("expecting boolean operand for '" + name + "'", *frame, ip);
+        }
+        if (TOP().as_bool() == (ip->base == OP_JUMP_IF_TRUE_OR_POP))
+          ip = frame->fun->code.data() + ip->a;
+        else {
+          ++ip;
+          POP();
+        }
+        DISPATCH();
+      }
+      TARGET(OP_FOR_PREP): {
+        if (not TOP().is_int() or not sp[-2].is_int())
+          error("expecting integer for loop bounds", *frame, ip);
+        Value* counter = frame->locals + ip->b;
+        counter[0] = sp[-2];
+        counter[1] = TOP();
+        POP();
+        POP();
+        if (counter[0].as_int() > counter[1].as_int())
+          ip = frame->fun->code.data() + ip->a;
+        else
+          ++ip;
+        DISPATCH();
+      }
+      TARGET(OP_FOR_LOOP): {
+        // (stopping at the limit, so the counter cannot overflow)
+        Value* counter = frame->locals + ip->b;
+        int i = counter[0].as_int();
+        if (i < counter[1].as_int()) {
+          Instr* from = ip;
+          counter[0] = Value::from_int(i + 1);
+          ip = frame->fun->code.data() + ip->a;
+          BACK_EDGE(from);
+        }
+        else
+          ++ip;
+        DISPATCH();
+      }
+      TARGET(OP_CALL):
+        frame->ip = ip + 1;
+        call(functions[ip->a], sp, ip->b);
+        frame = &frames.back();
+        ip = frame->ip;
+        NATIVE();
+        DISPATCH();
+      TARGET(OP_BUILTIN): {
+        int argc = ip->b;
+        Position p = position(*frame, ip);
+        {
+          Value result = rt.call_builtin(ip->a, sp - argc, argc, p.line, p.column);
+          for (int i = 0; i < argc; ++i)
+            POP();
+          PUSH(std::move(result));
+        }
+        ++ip;
+        DISPATCH();
+      }
+      TARGET(OP_RETURN): {
+        // the result replaces the callee's locals (and escapes if it
+        // is in the callee's region)
+        if (TOP().is_object() and local(TOP().as_object()) and
+            reinterpret_cast<char*>(TOP().as_object()) >= frame->region)
+          escape(TOP(), sp);
+        Value* locals = frame->locals;
+        if (sp - 1 != locals)
+          *locals = std::move(TOP());
+        while (sp != locals + 1)
+          POP();
+        pop_objects(*frame);
+        frames.pop_back();
+        if (frames.size() == exit_depth) {
+          POP();
+          return;
+        }
+        frame = &frames.back();
+        ip = frame->ip;
+        NATIVE();
+        DISPATCH();
+      }
+      TARGET(OP_ERROR):
+        error(constants[ip->a].as_string(), *frame, ip);
+        DISPATCH();
+      SUPERINSTRUCTION_HANDLERS
+      TARGET(Q_ADD_INT): QUICK_INT(true, Value::from_int(x + y))
+      TARGET(Q_SUB_INT): QUICK_INT(true, Value::from_int(x - y))
+      TARGET(Q_MUL_INT): QUICK_INT(true, Value::from_int(x * y))
+      TARGET(Q_DIV_INT): QUICK_INT(j != 0 and j != -1, Value::from_int(i / j))
+      TARGET(Q_MOD_INT): QUICK_INT(j != 0 and j != -1, Value::from_int(i % j))
+      TARGET(Q_EQ_INT): QUICK_INT(true, Value::from_bool(i == j))
+      TARGET(Q_NE_INT): QUICK_INT(true, Value::from_bool(i != j))
+      TARGET(Q_LT_INT): QUICK_INT(true, Value::from_bool(i < j))
+      TARGET(Q_LE_INT): QUICK_INT(true, Value::from_bool(i <= j))
+      TARGET(Q_GT_INT): QUICK_INT(true, Value::from_bool(i > j))
+      TARGET(Q_GE_INT): QUICK_INT(true, Value::from_bool(i >= j))
+      TARGET(Q_ADD_DOUBLE): QUICK_DOUBLE(Value::from_double(x + y))
+      TARGET(Q_SUB_DOUBLE): QUICK_DOUBLE(Value::from_double(x - y))
+      TARGET(Q_MUL_DOUBLE): QUICK_DOUBLE(Value::from_double(x * y))
+      TARGET(Q_DIV_DOUBLE): QUICK_DOUBLE(Value::from_double(x / y))
+      // (as the runtime compares: unordered NaNs are neither < nor >)
+      TARGET(Q_EQ_DOUBLE): QUICK_DOUBLE(Value::from_bool(x == y))
+      TARGET(Q_NE_DOUBLE): QUICK_DOUBLE(Value::from_bool(not (x == y)))
+      TARGET(Q_LT_DOUBLE): QUICK_DOUBLE(Value::from_bool(x < y))
+      TARGET(Q_LE_DOUBLE): QUICK_DOUBLE(Value::from_bool(not (x > y)))
+      TARGET(Q_GT_DOUBLE): QUICK_DOUBLE(Value::from_bool(x > y))
+      TARGET(Q_GE_DOUBLE): QUICK_DOUBLE(Value::from_bool(not (x < y)))
+      TARGET(Q_EQ_STRING): QUICK_STRING_EQ(true)
+      TARGET(Q_NE_STRING): QUICK_STRING_EQ(false)
+    }
+  generic_binary:
+    {
+      Value& lhs = sp[-2];
+      Position p = position(*frame, ip);
+      lhs = rt.binary(ops[ip->base - OP_ADD], lhs, TOP(), p.line, p.column);
+      POP();
+      ++ip;
+      DISPATCH();
+    }
+  }
+}
+
+
+#undef COUNT
+#undef TARGET
+#undef SUPER_TARGET
+#undef DISPATCH
+#undef PUSH
+#undef POP
+#undef TOP
+#undef NATIVE
+#undef BACK_EDGE
+#undef INT_BINARY
+#undef HANDLER
+#undef REDISPATCH
+#undef QUICKEN
+#undef DEQUICKEN
+#undef QUICK_INT
+#undef QUICK_DOUBLE
+#undef QUICK_STRING_EQ
+#undef SUPER_FALLBACK
+#undef SUPER_NEXT
+#undef BODY_INT_BINARY
+
+
+#endif